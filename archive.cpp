@@ -0,0 +1,480 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "archive.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+constexpr size_t TarBlockSize {512};
+constexpr size_t NewcHeaderSize {110};
+constexpr size_t OdcHeaderSize {76};
+constexpr std::string_view CpioTrailer {"TRAILER!!!"};
+
+constexpr uint64_t FileTypeMask {0170000};
+constexpr uint64_t RegularFile {0100000};
+
+// Number in the given base, after optional leading spaces and up to the
+// first space or NUL. Fails if there are no digits.
+bool parseNumber(std::span<const unsigned char> field, const uint64_t& base, uint64_t& value)
+{
+    size_t i = 0;
+    while (i < field.size() && field[i] == ' ') i++;
+
+    size_t first = i;
+    value = 0;
+
+    for (; i < field.size() && field[i] != ' ' && field[i] != '\0'; i++)
+    {
+        unsigned char c = field[i];
+        uint64_t digit;
+
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+
+        if (digit >= base) return false;
+
+        value = value * base + digit;
+    }
+
+    return i > first;
+}
+
+// Sizes too big for 11 octal digits are stored in base 256 by GNU tar,
+// flagged by the high bit of the first byte
+bool parseTarNumber(std::span<const unsigned char> field, uint64_t& value)
+{
+    if (!(field[0] & 0x80)) return parseNumber(field, 8, value);
+
+    value = field[0] & 0x7f;
+
+    for (size_t i = 1; i < field.size(); i++)
+        value = (value << 8) | field[i];
+
+    return true;
+}
+
+std::string_view fieldString(const unsigned char* field, const size_t& length)
+{
+    const char* text = reinterpret_cast<const char*>(field);
+    return {text, strnlen(text, length)};
+}
+
+// Archivers disagree on whether to store names as ./name or /name, and
+// tar stores directories as name/
+std::string_view normalize(std::string_view name)
+{
+    while (name.ends_with("/")) name.remove_suffix(1);
+
+    while (true)
+    {
+        if (name.starts_with("./")) name.remove_prefix(2);
+        else if (name.starts_with("/")) name.remove_prefix(1);
+        else return name;
+    }
+}
+
+bool validTarChecksum(const unsigned char* header)
+{
+    uint64_t stored;
+    if (!parseNumber({header + 148, 8}, 8, stored)) return false;
+
+    // The checksum field itself counts as spaces. Some old archivers summed
+    // signed bytes.
+    uint64_t sum = 0;
+    int64_t signedSum = 0;
+
+    for (size_t i = 0; i < TarBlockSize; i++)
+    {
+        unsigned char byte = (i >= 148 && i < 156) ? ' ' : header[i];
+        sum += byte;
+        signedSum += static_cast<signed char>(byte);
+    }
+
+    return stored == sum || int64_t(stored) == signedSum;
+}
+
+// Pax extended headers are records of the form "<length> <key>=<value>\n"
+bool paxPath(std::span<const unsigned char> data, std::string& path, bool& found)
+{
+    size_t offset = 0;
+
+    while (offset < data.size())
+    {
+        uint64_t length;
+        if (!parseNumber(data.subspan(offset), 10, length) || length == 0 ||
+                length > data.size() - offset)
+            return false;
+
+        std::string_view record = fieldString(data.data() + offset, length);
+        record = record.substr(0, std::min<size_t>(record.size(), length - 1));
+
+        size_t space = record.find(' ');
+        size_t equals = record.find('=');
+
+        if (space != std::string_view::npos && equals != std::string_view::npos && equals > space &&
+                record.substr(space + 1, equals - space - 1) == "path")
+        {
+            path = record.substr(equals + 1);
+            found = true;
+        }
+
+        offset += length;
+    }
+
+    return true;
+}
+
+}
+
+Archive::Archive()
+    : m_error{Error::NONE}
+{}
+
+Archive::~Archive()
+{
+    close();
+}
+
+const Archive::Error &Archive::error()
+{
+    return m_error;
+}
+
+std::string Archive::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case OPEN_FAILED:
+        return "Failed to open archive";
+    case READ_FAILED:
+        return "Failed to read archive";
+    case MMAP_FAILED:
+        return "Failed to map archive";
+    case INVALID_FORMAT:
+        return "Not a tar or cpio archive, or corrupted";
+    case MEMBER_NOT_FOUND:
+        return "No such file in archive";
+    case NOT_A_FILE:
+        return "Archive member is not a regular file";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool Archive::splitMemberPath(const std::string &path,
+                              std::filesystem::path &archivePath,
+                              std::string &memberPath)
+{
+    // Drive letters and other colons come before the archive name ends
+    for (size_t separator = path.find(Separator); separator != std::string::npos;
+         separator = path.find(Separator, separator + 1))
+    {
+        std::string_view archive{path.data(), separator};
+
+        if (separator + 1 == path.size() ||
+                std::none_of(std::begin(Extensions), std::end(Extensions),
+                             [&](const std::string_view& extension) { return archive.ends_with(extension); }))
+            continue;
+
+        archivePath = archive;
+        memberPath = path.substr(separator + 1);
+        return true;
+    }
+
+    return false;
+}
+
+bool Archive::open(const std::filesystem::path &archivePath)
+{
+    close();
+
+#ifdef __WIN32
+    std::ifstream file{archivePath, std::ios_base::in | std::ios_base::binary};
+
+    if (!file.is_open())
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    std::error_code sizeError;
+    auto size = std::filesystem::file_size(archivePath, sizeError);
+
+    if (sizeError)
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    m_fileData.resize(size);
+    file.read(reinterpret_cast<char*>(m_fileData.data()), m_fileData.size());
+
+    if (file.gcount() != static_cast<std::streamsize>(m_fileData.size()))
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    m_file = m_fileData;
+#else
+    int32_t fd = ::open(archivePath.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+    {
+        ::close(fd);
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    if (st.st_size == 0)
+    {
+        ::close(fd);
+        m_error = Error::INVALID_FORMAT;
+        return false;
+    }
+
+    // Not populated, bundles hold images for other boards as well
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        m_error = Error::MMAP_FAILED;
+        return false;
+    }
+
+    m_file = {static_cast<const unsigned char*>(map), static_cast<size_t>(st.st_size)};
+#endif
+
+    m_error = Error::NONE;
+    return true;
+}
+
+void Archive::close()
+{
+#ifdef __WIN32
+    m_fileData.clear();
+#else
+    if (!m_file.empty())
+        munmap(const_cast<unsigned char*>(m_file.data()), m_file.size());
+#endif
+
+    m_file = {};
+}
+
+bool Archive::find(std::string_view memberPath, std::span<const unsigned char> &contents)
+{
+    memberPath = normalize(memberPath);
+
+    bool found = (m_file.size() >= 6 && std::memcmp(m_file.data(), "0707", 4) == 0) ?
+                findCpio(memberPath, contents) : findTar(memberPath, contents);
+
+    if (!found) return false;
+
+#ifndef __WIN32
+    // Start reading the member in, and only the member, before it is sent
+    if (!contents.empty())
+    {
+        static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+        size_t start = (contents.data() - m_file.data()) / pageSize * pageSize;
+        size_t end = contents.data() - m_file.data() + contents.size();
+
+        madvise(const_cast<unsigned char*>(m_file.data()) + start, end - start, MADV_WILLNEED);
+    }
+#endif
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool Archive::findTar(std::string_view memberPath, std::span<const unsigned char> &contents)
+{
+    // Set by a GNU long name entry or a pax header for the entry after it
+    std::string longName;
+    bool hasLongName = false;
+
+    size_t offset = 0;
+
+    while (m_file.size() - offset >= TarBlockSize)
+    {
+        const unsigned char* header = m_file.data() + offset;
+
+        // Archives end with two zero blocks
+        if (std::all_of(header, header + TarBlockSize, [](const unsigned char& byte) { return byte == 0; }))
+            break;
+
+        uint64_t size;
+
+        if (!validTarChecksum(header) || !parseTarNumber({header + 124, 12}, size) ||
+                size > m_file.size() - offset - TarBlockSize)
+        {
+            m_error = Error::INVALID_FORMAT;
+            return false;
+        }
+
+        std::span<const unsigned char> data = m_file.subspan(offset + TarBlockSize, size);
+        unsigned char type = header[156];
+
+        offset += TarBlockSize + std::min<uint64_t>((size + TarBlockSize - 1) / TarBlockSize * TarBlockSize,
+                                                    m_file.size() - offset - TarBlockSize);
+
+        if (type == 'L')
+        {
+            longName = fieldString(data.data(), data.size());
+            hasLongName = true;
+            continue;
+        }
+
+        if (type == 'x')
+        {
+            if (!paxPath(data, longName, hasLongName))
+            {
+                m_error = Error::INVALID_FORMAT;
+                return false;
+            }
+            continue;
+        }
+
+        // Global pax headers apply to every entry, but never carry a path
+        if (type == 'g') continue;
+
+        std::string name;
+
+        if (hasLongName)
+        {
+            name = longName;
+            hasLongName = false;
+        }
+        else
+        {
+            name = fieldString(header, 100);
+
+            std::string_view prefix = fieldString(header + 345, 155);
+            if (std::memcmp(header + 257, "ustar", 5) == 0 && !prefix.empty())
+                name = std::string{prefix} + "/" + name;
+        }
+
+        if (normalize(name) != memberPath) continue;
+
+        // '7' is a contiguous file, which reads like a regular one
+        if (type != '0' && type != '\0' && type != '7')
+        {
+            m_error = Error::NOT_A_FILE;
+            return false;
+        }
+
+        contents = data;
+        return true;
+    }
+
+    m_error = Error::MEMBER_NOT_FOUND;
+    return false;
+}
+
+bool Archive::findCpio(std::string_view memberPath, std::span<const unsigned char> &contents)
+{
+    size_t offset = 0;
+
+    while (m_file.size() - offset >= 6)
+    {
+        const unsigned char* header = m_file.data() + offset;
+
+        uint64_t mode, nameSize, fileSize;
+        size_t nameOffset, dataOffset, next;
+
+        auto align = [](const uint64_t& value) { return (value + 3) & ~uint64_t{3}; };
+
+        if ((std::memcmp(header, "070701", 6) == 0 || std::memcmp(header, "070702", 6) == 0) &&
+                m_file.size() - offset >= NewcHeaderSize &&
+                parseNumber({header + 14, 8}, 16, mode) &&
+                parseNumber({header + 54, 8}, 16, fileSize) &&
+                parseNumber({header + 94, 8}, 16, nameSize))
+        {
+            // Names and data are padded to four bytes
+            nameOffset = offset + NewcHeaderSize;
+            dataOffset = align(nameOffset + nameSize);
+            next = align(dataOffset + fileSize);
+        }
+        else if (std::memcmp(header, "070707", 6) == 0 &&
+                 m_file.size() - offset >= OdcHeaderSize &&
+                 parseNumber({header + 18, 6}, 8, mode) &&
+                 parseNumber({header + 59, 6}, 8, nameSize) &&
+                 parseNumber({header + 65, 11}, 8, fileSize))
+        {
+            nameOffset = offset + OdcHeaderSize;
+            dataOffset = nameOffset + nameSize;
+            next = dataOffset + fileSize;
+        }
+        else
+        {
+            m_error = Error::INVALID_FORMAT;
+            return false;
+        }
+
+        // Names include their NUL
+        if (nameSize == 0 || nameSize > m_file.size() || fileSize > m_file.size() ||
+                dataOffset + fileSize > m_file.size())
+        {
+            m_error = Error::INVALID_FORMAT;
+            return false;
+        }
+
+        std::string_view name = fieldString(m_file.data() + nameOffset, nameSize - 1);
+
+        if (name == CpioTrailer) break;
+
+        if (normalize(name) == memberPath)
+        {
+            if ((mode & FileTypeMask) != RegularFile)
+            {
+                m_error = Error::NOT_A_FILE;
+                return false;
+            }
+
+            contents = m_file.subspan(dataOffset, fileSize);
+            return true;
+        }
+
+        offset = std::min<size_t>(next, m_file.size());
+    }
+
+    m_error = Error::MEMBER_NOT_FOUND;
+    return false;
+}
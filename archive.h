@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only view of a tar or cpio archive, so that images can be uploaded
+// straight out of a firmware bundle without extracting them. The archive
+// is mapped and members are served from the mapping.
+//
+// tar: ustar, GNU and v7, with long names from GNU 'L' entries and pax
+// path records. cpio: new ASCII (070701, 070702) and old portable ASCII
+// (070707). Compressed archives are not supported.
+class Archive
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        OPEN_FAILED,
+        READ_FAILED,
+        MMAP_FAILED,
+        INVALID_FORMAT,
+        MEMBER_NOT_FOUND,
+        NOT_A_FILE
+    };
+
+    // Separates the archive from the member, e.g. bundle.tar:images/board.bin
+    constexpr static char Separator {':'};
+    constexpr static std::string_view Extensions[] {".tar", ".cpio"};
+
+    Archive();
+    ~Archive();
+
+    Archive(const Archive&) = delete;
+    Archive& operator=(const Archive&) = delete;
+
+    const Error& error();
+    std::string errorStr();
+
+    // Splits path into the archive and the member inside it. Returns false
+    // if path does not name a member of an archive.
+    static bool splitMemberPath(const std::string& path,
+                                std::filesystem::path& archivePath,
+                                std::string& memberPath);
+
+    bool open(const std::filesystem::path& archivePath);
+    void close();
+
+    // Contents of the regular file memberPath, valid until close(). Leading
+    // "./" and "/" are ignored on both sides.
+    bool find(std::string_view memberPath, std::span<const unsigned char>& contents);
+
+private:
+    Error m_error;
+
+    std::span<const unsigned char> m_file;
+#ifdef __WIN32
+    std::vector<unsigned char> m_fileData;
+#endif
+
+    bool findTar(std::string_view memberPath, std::span<const unsigned char>& contents);
+    bool findCpio(std::string_view memberPath, std::span<const unsigned char>& contents);
+};
+
+#endif // ARCHIVE_H
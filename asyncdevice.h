@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef ASYNCDEVICE_H
+#define ASYNCDEVICE_H
+
+#include <span>
+#include <cstddef>
+#include <chrono>
+#include "task.h"
+
+// Counterpart of Device for use from coroutines.
+class AsyncDevice
+{
+public:
+
+    virtual ~AsyncDevice() = default;
+
+    // Completes with bytesRead set to 0 if nothing arrived before the read timeout.
+    virtual Task<bool> readSomeAsync(std::span<unsigned char> bytes, size_t& bytesRead) = 0;
+    virtual Task<bool> writeAsync(std::span<const unsigned char> bytes) = 0;
+
+    // Time left until every byte written so far has been transmitted
+    virtual std::chrono::microseconds pendingTransmitTime()
+    {
+        return std::chrono::microseconds{0};
+    }
+};
+
+#endif // ASYNCDEVICE_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "asyncserialdevice.h"
+
+#ifdef __linux
+
+AsyncSerialDevice::AsyncSerialDevice(EventLoop& loop,
+                                     const std::filesystem::path& devicePath,
+                                     const DeviceProperties& deviceProperties,
+                                     const int32_t& readTimeout)
+    : SerialDevice{devicePath, deviceProperties, readTimeout},
+      m_loop{loop}
+{}
+
+bool AsyncSerialDevice::open()
+{
+    if (!SerialDevice::open()) return false;
+
+    int32_t flags = fcntl(m_linuxFD, F_GETFL);
+
+    if (flags < 0 || fcntl(m_linuxFD, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        m_error = Error::FAILED_TO_SET_FD_ATTRS;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+Task<bool> AsyncSerialDevice::readSomeAsync(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        co_return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_readTimeout);
+
+    while (true)
+    {
+        ssize_t result = ::read(m_linuxFD, bytes.data(), bytes.size());
+
+        if (result > 0 || (result == 0 && bytes.empty()))
+        {
+            bytesRead = result;
+            m_error = Error::NONE;
+            co_return true;
+        }
+
+        if (result < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            m_error = Error::READ_FAILED;
+            co_return false;
+        }
+
+        // Nothing available yet. Read timeouts under 100 ms leave VTIME at 0,
+        // which makes the read return 0 instead of failing with EAGAIN, so
+        // both wait on the loop rather than return to the caller.
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+
+        // Timed out, report an empty read like SerialDevice does
+        if (remaining <= 0)
+        {
+            m_error = Error::NONE;
+            co_return true;
+        }
+
+        auto waiter = m_loop.readable(m_linuxFD, remaining);
+
+        if (!co_await waiter)
+        {
+            if (waiter.failed())
+            {
+                m_error = Error::READ_FAILED;
+                co_return false;
+            }
+
+            m_error = Error::NONE;
+            co_return true;
+        }
+    }
+}
+
+Task<bool> AsyncSerialDevice::writeAsync(std::span<const unsigned char> bytes)
+{
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        co_return false;
+    }
+
+    while (!bytes.empty())
+    {
+        ssize_t result = ::write(m_linuxFD, bytes.data(), bytes.size());
+
+        if (result >= 0)
+        {
+            bytes = bytes.subspan(result);
+            continue;
+        }
+
+        if ((errno != EAGAIN && errno != EINTR) ||
+                !co_await m_loop.writable(m_linuxFD, m_readTimeout))
+        {
+            m_error = Error::WRITE_FAILED;
+            co_return false;
+        }
+    }
+
+    m_error = Error::NONE;
+    co_return true;
+}
+
+std::chrono::microseconds AsyncSerialDevice::pendingTransmitTime()
+{
+    return SerialDevice::pendingTransmitTime();
+}
+
+#endif
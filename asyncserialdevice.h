@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef ASYNCSERIALDEVICE_H
+#define ASYNCSERIALDEVICE_H
+
+#ifdef __linux
+
+#include "serialdevice.h"
+#include "asyncdevice.h"
+#include "eventloop.h"
+
+// Serial device in non-blocking mode, waiting for the port through an EventLoop.
+class AsyncSerialDevice : public SerialDevice, public AsyncDevice
+{
+public:
+
+    AsyncSerialDevice(EventLoop& loop,
+                      const std::filesystem::path& devicePath,
+                      const DeviceProperties& deviceProperties,
+                      const int32_t& readTimeout);
+
+    bool open();
+
+    Task<bool> readSomeAsync(std::span<unsigned char> bytes, size_t& bytesRead);
+    Task<bool> writeAsync(std::span<const unsigned char> bytes);
+
+    std::chrono::microseconds pendingTransmitTime();
+
+private:
+    EventLoop& m_loop;
+};
+
+#endif
+
+#endif // ASYNCSERIALDEVICE_H
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "asyncxmodem.h"
+#include "xmodemsender.h"
+#include "sharedstatus.h"
+
+#include "logger.h"
+
+AsyncXModem::AsyncXModem(AsyncDevice& device, const int32_t& maxRetry, const int32_t &blockSize)
+    : m_error{XModem::Error::NONE},
+      m_device{device},
+      m_maxRetry{maxRetry},
+      m_blockSize{blockSize},
+      m_sharedStatus{nullptr}
+{}
+
+const XModem::Error &AsyncXModem::error()
+{
+    return m_error;
+}
+
+std::string AsyncXModem::errorStr()
+{
+    return XModem::errorStr(m_error);
+}
+
+void AsyncXModem::setTimeouts(const XModem::Timeouts &timeouts)
+{
+    m_timeouts = timeouts;
+}
+
+void AsyncXModem::setSharedStatus(SharedStatus *status)
+{
+    m_sharedStatus = status;
+}
+
+void AsyncXModem::setPatches(const XModem::Patches &patches)
+{
+    m_patches = patches;
+}
+
+void AsyncXModem::publishStatus(XModemSender &sender, const bool &failed)
+{
+    if (m_sharedStatus == nullptr) return;
+
+    m_sharedStatus->publish(failed ? XModemSender::State::FAILED : sender.state(),
+                            failed ? m_error : XModem::Error::NONE,
+                            std::min(sender.currentBlock(), sender.noOfBlocks()), sender.noOfBlocks(),
+                            sender.retries(), std::min(sender.currentBlock(), sender.noOfBlocks()) * m_blockSize);
+}
+
+Task<bool> AsyncXModem::upload(std::filesystem::path filePath,
+                               bool startAfterUpload,
+                               bool showProgress)
+{
+    XModemSender sender{m_maxRetry, m_blockSize, m_timeouts, XModem::steadyClock};
+
+    if (!sender.open(filePath) || !sender.patch(m_patches))
+    {
+        m_error = sender.error();
+        publishStatus(sender, true);
+        co_return false;
+    }
+
+    unsigned char rb;
+    size_t bytesRead;
+
+    while(true)
+    {
+        publishStatus(sender, false);
+
+        if (!co_await m_device.readSomeAsync({&rb, 1}, bytesRead))
+            break;
+
+        XModemSender::Action action = (bytesRead == 0) ? sender.timeout() : sender.respond(rb);
+
+        if (action == XModemSender::Action::WAIT)
+        {
+            continue;
+        }
+        else if (action == XModemSender::Action::FAIL)
+        {
+            m_error = sender.error();
+            publishStatus(sender, true);
+            co_return false;
+        }
+        else if (action == XModemSender::Action::DONE)
+        {
+            if (startAfterUpload)
+                if (!co_await m_device.writeAsync({&XModem::CR, 1})) break;
+
+            if (showProgress)
+                Logger::get() << Logger::NewLine;
+
+            sender.close();
+            m_error = XModem::Error::NONE;
+            publishStatus(sender, false);
+            co_return true;
+        }
+        else if (action == XModemSender::Action::SEND_EOT)
+        {
+            if (!co_await m_device.writeAsync({&XModem::EOT, 1})) break;
+
+            sender.sent(m_device.pendingTransmitTime());
+            continue;
+        }
+
+        if (!co_await m_device.writeAsync(sender.packet())) break;
+
+        sender.sent(m_device.pendingTransmitTime());
+
+        if (showProgress)
+            sender.showProgress();
+    }
+
+    m_error = XModem::Error::DEVICE_RELATED;
+    publishStatus(sender, true);
+    co_return false;
+}
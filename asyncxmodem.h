@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef ASYNCXMODEM_H
+#define ASYNCXMODEM_H
+
+#include "xmodem.h"
+#include "asyncdevice.h"
+
+// XModem upload as a coroutine, so many transfers can share one thread.
+class AsyncXModem
+{
+public:
+
+    AsyncXModem(AsyncDevice& device,
+                const int32_t& maxRetry,
+                const int32_t& blockSize);
+
+    const XModem::Error& error();
+    std::string errorStr();
+
+    void setTimeouts(const XModem::Timeouts& timeouts);
+
+    // Publishes the state of the upload into status, nullptr disables it
+    void setSharedStatus(SharedStatus* status);
+
+    // Applied to every upload, see XModem::setPatches
+    void setPatches(const XModem::Patches& patches);
+
+    // Progress is only printed when showProgress is set, since
+    // concurrent transfers would overwrite each others progress bar.
+    // Arguments are taken by value, the task only starts once spawned.
+    Task<bool> upload(std::filesystem::path filePath,
+                      bool startAfterUpload,
+                      bool showProgress);
+
+private:
+    XModem::Error m_error;
+    AsyncDevice& m_device;
+    int32_t m_maxRetry;
+    int32_t m_blockSize;
+    XModem::Timeouts m_timeouts;
+    SharedStatus* m_sharedStatus;
+    XModem::Patches m_patches;
+
+    void publishStatus(XModemSender& sender, const bool& failed);
+};
+
+#endif // ASYNCXMODEM_H
@@ -0,0 +1,955 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "binarylogger.h"
+#include "crc.h"
+#include "faultdevice.h"
+#include "logger.h"
+#include "packetfile.h"
+#include "replaydevice.h"
+#include "simulateddevice.h"
+#include "xmodem.h"
+#include "xmodemsender.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+// Allocations made by this thread while set
+thread_local bool countAllocations = false;
+std::atomic<size_t> allocations {0};
+
+}
+
+// Replaced for the whole program, so that uploads can be checked for
+// allocations. Array and sized forms end up in these by default.
+void* operator new(std::size_t size)
+{
+    if (countAllocations) allocations++;
+
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+
+constexpr int32_t BlockSize {ARIES_XMODEM_BLOCK_SIZE};
+constexpr int32_t BaudRate {115200};
+constexpr int32_t ReadTimeout {500};
+constexpr int32_t MaxRetry {10};
+constexpr size_t ImageSize {32 * 1024};
+constexpr uint64_t Seeds {20};
+
+// Every microbenchmark runs for at least this long
+constexpr std::chrono::milliseconds MinDuration {200};
+
+// Board that acknowledges every write on the spot, without any syscalls,
+// so that only the host side of the protocol is measured.
+class AckDevice : public Device
+{
+public:
+    bool read(std::span<unsigned char> bytes)
+    {
+        size_t bytesRead;
+        return readSome(bytes, bytesRead) && bytesRead == bytes.size();
+    }
+
+    bool write(std::span<const unsigned char>)
+    {
+        m_reply = XModem::ACK;
+        return true;
+    }
+
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+    {
+        bytesRead = 0;
+
+        if (bytes.empty() || !m_reply) return true;
+
+        bytes[0] = *m_reply;
+        bytesRead = 1;
+        m_reply.reset();
+        return true;
+    }
+
+    void reset()
+    {
+        m_reply = XModem::C;
+    }
+
+private:
+    std::optional<unsigned char> m_reply {XModem::C};
+};
+
+// Board that never answers, apart from an optional first 'C'. Reads cost one
+// read timeout, and fail past a time limit so that a sender that never gives
+// up is caught instead of hanging the check.
+class MuteDevice : public Device
+{
+public:
+    MuteDevice(const bool& handshake)
+        : m_handshake{handshake}
+    {}
+
+    bool read(std::span<unsigned char> bytes)
+    {
+        size_t bytesRead;
+        return readSome(bytes, bytesRead) && bytesRead == bytes.size();
+    }
+
+    bool write(std::span<const unsigned char>)
+    {
+        return true;
+    }
+
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+    {
+        bytesRead = 0;
+        m_elapsed += std::chrono::milliseconds{ReadTimeout};
+
+        if (m_elapsed > TimeLimit) return false;
+
+        if (!bytes.empty() && m_handshake)
+        {
+            bytes[0] = XModem::C;
+            bytesRead = 1;
+            m_handshake = false;
+        }
+
+        return true;
+    }
+
+    std::chrono::microseconds elapsed()
+    {
+        return m_elapsed;
+    }
+
+    constexpr static std::chrono::microseconds TimeLimit {std::chrono::minutes{10}};
+
+private:
+    bool m_handshake;
+    std::chrono::microseconds m_elapsed {0};
+};
+
+// Sender with an empty file, which answers the first 'C' with EOT
+class EmptySenderDevice : public Device
+{
+public:
+    bool read(std::span<unsigned char> bytes)
+    {
+        size_t bytesRead;
+        return readSome(bytes, bytesRead) && bytesRead == bytes.size();
+    }
+
+    bool write(std::span<const unsigned char> bytes)
+    {
+        for (auto& byte : bytes)
+        {
+            if (byte == XModem::C && !m_eotSent) m_reply = XModem::EOT;
+            if (byte == XModem::ACK && m_eotSent) m_acked = true;
+        }
+
+        return true;
+    }
+
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+    {
+        bytesRead = 0;
+
+        if (bytes.empty() || !m_reply) return true;
+
+        bytes[0] = *m_reply;
+        bytesRead = 1;
+        m_reply.reset();
+        m_eotSent = true;
+        return true;
+    }
+
+    bool acked()
+    {
+        return m_acked;
+    }
+
+private:
+    std::optional<unsigned char> m_reply;
+    bool m_eotSent {false};
+    bool m_acked {false};
+};
+
+// Counts what the host allocates from writing its first packet until it
+// writes EOT, which is the part of an upload run once per block. Calls
+// into the board behind it are not counted.
+class AllocationProbe : public Device
+{
+public:
+    AllocationProbe(Device& device)
+        : m_device{device},
+          m_counting{false}
+    {}
+
+    bool read(std::span<unsigned char> bytes)
+    {
+        countAllocations = false;
+        bool result = m_device.read(bytes);
+        countAllocations = m_counting;
+        return result;
+    }
+
+    bool write(std::span<const unsigned char> bytes)
+    {
+        if (bytes.size() > 1) m_counting = true;
+        else if (bytes.size() == 1 && bytes[0] == XModem::EOT) m_counting = false;
+
+        countAllocations = false;
+        bool result = m_device.write(bytes);
+        countAllocations = m_counting;
+        return result;
+    }
+
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+    {
+        countAllocations = false;
+        bool result = m_device.readSome(bytes, bytesRead);
+        countAllocations = m_counting;
+        return result;
+    }
+
+private:
+    Device& m_device;
+    bool m_counting;
+};
+
+// Swallows everything Logger writes to stderr while it is being measured
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c)
+    {
+        return c;
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize count)
+    {
+        return count;
+    }
+};
+
+struct Measurement
+{
+    std::string name;
+    double nsPerOp;
+    double bytesPerOp;
+};
+
+template<typename Operation>
+Measurement measure(const std::string& name, const double& bytesPerOp, Operation&& operation)
+{
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t iterations = 1;
+
+    while (true)
+    {
+        auto start = Clock::now();
+
+        for (uint64_t i = 0; i < iterations; i++)
+            operation();
+
+        auto elapsed = Clock::now() - start;
+
+        if (elapsed >= MinDuration)
+            return {name, std::chrono::duration<double, std::nano>(elapsed).count() / iterations, bytesPerOp};
+
+        iterations *= 2;
+    }
+}
+
+std::vector<unsigned char> randomImage(const size_t& size)
+{
+    std::vector<unsigned char> image(size);
+    std::mt19937_64 random{1};
+    for (auto& byte : image) byte = random();
+    return image;
+}
+
+std::vector<Measurement> benchHotPaths()
+{
+    std::vector<Measurement> measurements;
+    std::vector<unsigned char> image = randomImage(ImageSize);
+
+    // Results are folded into this so the work cannot be optimised away
+    volatile uint32_t sink = 0;
+
+    // 1000 bytes goes through the generic framing path, for comparison
+    for (size_t size : {size_t{128}, size_t{1000}, size_t{1024}})
+    {
+        std::span<const unsigned char> block{image.data(), size};
+
+        measurements.push_back(measure("crc16 " + std::to_string(size) + " bytes", size, [&] {
+            sink = sink + CRC::generateCRC16CCITT(block);
+        }));
+
+        std::vector<unsigned char> packet(3 + size + 2);
+
+        measurements.push_back(measure("frame " + std::to_string(size) + " bytes", size, [&] {
+            XModemSender::frame(packet, 7, block);
+            sink = sink + packet.back();
+        }));
+    }
+
+    measurements.push_back(measure("crc16 128 bytes fixed", 128, [&] {
+        sink = sink + CRC::generateCRC16CCITT(std::span<const unsigned char, 128>{image.data(), 128});
+    }));
+
+    measurements.push_back(measure("crc16 1024 bytes fixed", 1024, [&] {
+        sink = sink + CRC::generateCRC16CCITT(std::span<const unsigned char, 1024>{image.data(), 1024});
+    }));
+
+    AckDevice board;
+    XModem modem{board, MaxRetry, BlockSize};
+    modem.setProgressCallback([](const size_t&, const size_t&) {});
+
+    size_t noOfBlocks = (ImageSize + BlockSize - 1) / BlockSize;
+
+    Measurement upload = measure("upload per block", BlockSize, [&] {
+        board.reset();
+        sink = sink + modem.upload(image, false);
+    });
+    upload.nsPerOp /= noOfBlocks;
+    measurements.push_back(upload);
+
+    // Personalised uploads of a packed image, where only the block holding
+    // the serial number is framed again
+    std::filesystem::path imagePath = std::filesystem::temp_directory_path() / "vegadude_bench.bin";
+    std::filesystem::path packetPath = std::filesystem::temp_directory_path() / "vegadude_bench.vdpkt";
+
+    std::FILE* imageFile = std::fopen(imagePath.c_str(), "wb");
+
+    if (imageFile != nullptr)
+    {
+        bool written = std::fwrite(image.data(), 1, image.size(), imageFile) == image.size();
+        std::fclose(imageFile);
+
+        PacketFile packetFile;
+
+        if (written && packetFile.pack(imagePath, packetPath, BlockSize))
+        {
+            modem.setPatches({{ImageSize / 2, std::vector<unsigned char>(16, 0xa5)}});
+
+            Measurement patched = measure("upload packed patched", BlockSize, [&] {
+                board.reset();
+                sink = sink + modem.upload(packetPath, false);
+            });
+            patched.nsPerOp /= noOfBlocks;
+            measurements.push_back(patched);
+
+            // Same for the raw image, whose packets are framed once and reused
+            Measurement rawPatched = measure("upload raw patched", BlockSize, [&] {
+                board.reset();
+                sink = sink + modem.upload(imagePath, false);
+            });
+            rawPatched.nsPerOp /= noOfBlocks;
+            measurements.push_back(rawPatched);
+
+            modem.setPatches({});
+        }
+
+        std::filesystem::remove(imagePath);
+        std::filesystem::remove(packetPath);
+    }
+
+    NullBuffer null;
+    std::streambuf* stderrBuffer = std::cerr.rdbuf(&null);
+
+    size_t block = 0;
+
+    measurements.push_back(measure("logger showProgress", 0, [&] {
+        block = (block + 1) % noOfBlocks;
+        Logger::get().showProgress("Sent block " + std::to_string(block) + "/" + std::to_string(noOfBlocks),
+                                   float(block) / float(noOfBlocks));
+    }));
+
+    measurements.push_back(measure("logger operator<<", 0, [&] {
+        Logger::get() << "Device Path: " << block << Logger::NewLine;
+    }));
+
+    std::cerr.rdbuf(stderrBuffer);
+
+    // Only the cost to the logging thread, the buffer fills up at this rate
+    // so most of these entries end up counted as dropped
+    std::filesystem::path logPath = std::filesystem::temp_directory_path() / "vegadude_bench.vdlog";
+
+    if (BinaryLogger::get().start(logPath, false))
+    {
+        static const uint16_t format = BinaryLogger::registerFormat("upload {}: block {}/{} acknowledged");
+
+        measurements.push_back(measure("binary log entry", 0, [&] {
+            block = (block + 1) % noOfBlocks;
+            BinaryLogger::get().log(format, uint32_t{0}, block, noOfBlocks);
+        }));
+
+        BinaryLogger::get().stop();
+        std::filesystem::remove(logPath);
+    }
+
+    return measurements;
+}
+
+// Uploads to a simulated board through the default progress bar and
+// returns how many allocations were made between the handshake and EOT
+size_t benchAllocations()
+{
+    std::vector<unsigned char> image = randomImage(ImageSize);
+
+    SimulatedDevice board{BlockSize, BaudRate, ReadTimeout};
+    AllocationProbe probe{board};
+
+    XModem modem{probe, MaxRetry, BlockSize};
+    modem.setClock([&board] { return std::chrono::microseconds(board.elapsed()); });
+
+    NullBuffer null;
+    std::streambuf* stderrBuffer = std::cerr.rdbuf(&null);
+
+    allocations = 0;
+    bool uploaded = modem.upload(image, false);
+    countAllocations = false;
+
+    std::cerr.rdbuf(stderrBuffer);
+
+    if (!uploaded || !board.complete())
+    {
+        std::fprintf(stderr, "Allocation check upload failed\n");
+        return SIZE_MAX;
+    }
+
+    return allocations;
+}
+
+struct UploadResult
+{
+    bool success;
+    uint64_t elapsed;
+    size_t faults;
+};
+
+UploadResult upload(std::span<const unsigned char> image,
+                    const FaultDevice::Faults& faults,
+                    const uint64_t& seed,
+                    const uint64_t& timeLimit)
+{
+    SimulatedDevice board{BlockSize, BaudRate, ReadTimeout};
+    board.setTimeLimit(timeLimit);
+    FaultDevice line{board, faults, seed};
+
+    XModem modem{line, MaxRetry, BlockSize};
+    modem.setProgressCallback([](const size_t&, const size_t&) {});
+    modem.setClock([&board] { return std::chrono::microseconds(board.elapsed()); });
+
+    bool uploaded = modem.upload(image, false);
+
+    const std::vector<unsigned char>& received = board.received();
+    bool intact = board.complete() &&
+            received.size() >= image.size() &&
+            std::equal(image.begin(), image.end(), received.begin());
+
+    // Faults that stalled a read cost the host one read timeout each
+    uint64_t elapsed = board.elapsed() + line.stats().delays * ReadTimeout * 1000ULL;
+
+    return {uploaded && intact, elapsed, line.stats().total()};
+}
+
+struct Scenario
+{
+    std::string_view name;
+    double FaultDevice::Faults::* fault;
+};
+
+struct Recovery
+{
+    std::string_view name;
+    double rate;
+    double success;
+    // Only meaningful if at least one upload succeeded
+    double throughput;
+    double loss;
+    double recoveryPerFault;
+};
+
+struct FaultRecovery
+{
+    double baselineThroughput;
+    double baselineElapsed;
+    std::vector<Recovery> results;
+};
+
+FaultRecovery benchFaultRecovery()
+{
+    std::vector<unsigned char> image = randomImage(ImageSize);
+
+    UploadResult baseline = upload(image, {}, 0, 0);
+
+    // A transfer taking this long is counted as stuck
+    uint64_t timeLimit = baseline.elapsed * 20;
+
+    FaultRecovery recovery;
+    recovery.baselineThroughput = image.size() / (baseline.elapsed / 1e6);
+    recovery.baselineElapsed = baseline.elapsed / 1e6;
+
+    constexpr Scenario scenarios[] {
+        {"bit flip", &FaultDevice::Faults::bitFlip},
+        {"drop", &FaultDevice::Faults::drop},
+        {"duplicate ack", &FaultDevice::Faults::duplicateAck},
+        {"delay", &FaultDevice::Faults::delay},
+        {"spurious C", &FaultDevice::Faults::spuriousC},
+        {"spurious CAN", &FaultDevice::Faults::spuriousCan},
+        {"noise", &FaultDevice::Faults::noise}
+    };
+
+    constexpr double rates[] {0.0001, 0.001, 0.01};
+
+    for (auto& scenario : scenarios)
+    {
+        for (auto& rate : rates)
+        {
+            FaultDevice::Faults faults;
+            faults.*scenario.fault = rate;
+
+            size_t successes = 0;
+            double elapsed = 0;
+            double extra = 0;
+            size_t injected = 0;
+
+            for (uint64_t seed = 1; seed <= Seeds; seed++)
+            {
+                UploadResult result = upload(image, faults, seed, timeLimit);
+                if (!result.success) continue;
+
+                successes++;
+                elapsed += result.elapsed;
+                extra += double(result.elapsed) - double(baseline.elapsed);
+                injected += result.faults;
+            }
+
+            Recovery result{scenario.name, rate, double(successes) / Seeds, 0, 0, 0};
+
+            if (successes > 0)
+            {
+                result.throughput = image.size() / (elapsed / successes / 1e6);
+                result.loss = 1 - result.throughput / recovery.baselineThroughput;
+                result.recoveryPerFault = injected ? extra / injected / 1e3 : 0.0;
+            }
+
+            recovery.results.push_back(result);
+        }
+    }
+
+    return recovery;
+}
+
+// Regressions in what is sent, rather than how fast. Run with --check.
+struct Check
+{
+    std::string_view name;
+    bool (*run)();
+};
+
+// Block counts of images past 2^24 bytes used to be rounded through a float,
+// so the last block was never sent and the packet file header was rejected
+bool checkLargeImage()
+{
+    std::vector<unsigned char> image = randomImage((size_t(1) << 24) + 1);
+    size_t noOfBlocks = (image.size() + BlockSize - 1) / BlockSize;
+
+    SimulatedDevice board{BlockSize, BaudRate, ReadTimeout};
+    XModem modem{board, MaxRetry, BlockSize};
+    modem.setProgressCallback([](const size_t&, const size_t&) {});
+    modem.setClock([&board] { return std::chrono::microseconds(board.elapsed()); });
+
+    const std::vector<unsigned char>& received = board.received();
+
+    if (!modem.upload(image, false) || !board.complete() ||
+            received.size() != noOfBlocks * BlockSize ||
+            !std::equal(image.begin(), image.end(), received.begin()))
+        return false;
+
+    std::filesystem::path imagePath = std::filesystem::temp_directory_path() / "vegadude_check.bin";
+    std::filesystem::path packetPath = std::filesystem::temp_directory_path() / "vegadude_check.vdpkt";
+
+    std::FILE* imageFile = std::fopen(imagePath.c_str(), "wb");
+    if (imageFile == nullptr) return false;
+
+    bool written = std::fwrite(image.data(), 1, image.size(), imageFile) == image.size();
+    std::fclose(imageFile);
+
+    PacketFile packetFile;
+    bool packed = written &&
+            packetFile.pack(imagePath, packetPath, BlockSize) &&
+            packetFile.open(packetPath) &&
+            packetFile.noOfBlocks() == noOfBlocks;
+
+    packetFile.close();
+    std::filesystem::remove(imagePath);
+    std::filesystem::remove(packetPath);
+
+    return packed;
+}
+
+// A target that keeps printing must still run into the handshake and ACK
+// deadlines, which used to be checked only after an empty read
+XModem::Error uploadToNoisyMuteBoard(const bool& handshake)
+{
+    MuteDevice board{handshake};
+
+    FaultDevice::Faults faults;
+    faults.noise = 1;
+    FaultDevice line{board, faults, 1};
+
+    XModem modem{line, MaxRetry, BlockSize};
+    modem.setProgressCallback([](const size_t&, const size_t&) {});
+    modem.setClock([&board] { return board.elapsed(); });
+    modem.setTimeouts({.handshake = 5000});
+
+    std::vector<unsigned char> image = randomImage(BlockSize * 4);
+    modem.upload(image, false);
+
+    return modem.error();
+}
+
+bool checkNoisyHandshake()
+{
+    return uploadToNoisyMuteBoard(false) == XModem::Error::HANDSHAKE_TIMED_OUT;
+}
+
+bool checkNoisyAck()
+{
+    return uploadToNoisyMuteBoard(true) == XModem::Error::MAX_RETRY_SURPASSED;
+}
+
+// An EOT before any block used to be ignored until the handshake timed out
+bool checkEmptyDownload()
+{
+    EmptySenderDevice sender;
+    XModem modem{sender, MaxRetry, BlockSize};
+    modem.setProgressCallback([](const size_t&, const size_t&) {});
+    modem.setTimeouts({.handshake = 5000});
+
+    std::filesystem::path outputPath = std::filesystem::temp_directory_path() / "vegadude_check_empty.bin";
+
+    // Stays non-empty if the download never writes the file
+    if (std::FILE* output = std::fopen(outputPath.c_str(), "wb"))
+    {
+        std::fputc('x', output);
+        std::fclose(output);
+    }
+
+    bool downloaded = modem.download(outputPath, false);
+
+    std::error_code error;
+    bool empty = std::filesystem::file_size(outputPath, error) == 0 && !error;
+    std::filesystem::remove(outputPath, error);
+
+    return downloaded && sender.acked() && empty;
+}
+
+bool runChecks()
+{
+    constexpr Check checks[] {
+        {"image over 16 MiB", checkLargeImage},
+        {"handshake deadline under noise", checkNoisyHandshake},
+        {"ACK deadline under noise", checkNoisyAck},
+        {"download of an empty file", checkEmptyDownload}
+    };
+
+    bool passed = true;
+
+    for (auto& check : checks)
+    {
+        bool result = check.run();
+        std::printf("%-32s %s\n", check.name.data(), result ? "ok" : "FAILED");
+        passed = passed && result;
+    }
+
+    return passed;
+}
+
+struct Replay
+{
+    bool success;
+    int32_t blockSize;
+    size_t records;
+    // Seconds
+    double captured;
+    double replayed;
+    double hostOnly;
+    size_t divergences;
+};
+
+bool replayUpload(const std::filesystem::path& capturePath,
+                  const std::filesystem::path& binaryPath,
+                  const int32_t& blockSize,
+                  const double& timeScale,
+                  double& elapsed,
+                  size_t& divergences)
+{
+    ReplayDevice board{capturePath, ReadTimeout, timeScale};
+    if (!board.open()) return false;
+
+    XModem modem{board, MaxRetry, blockSize};
+    modem.setProgressCallback([](const size_t&, const size_t&) {});
+
+    auto start = std::chrono::steady_clock::now();
+    bool uploaded = modem.upload(binaryPath, false);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    divergences = board.divergences();
+    return uploaded;
+}
+
+// Uploads binaryPath against the target's side of a capture, once with
+// its original timing and once without any waits, which leaves only the
+// time spent on the host
+std::optional<Replay> benchReplay(const std::filesystem::path& capturePath,
+                                  const std::filesystem::path& binaryPath)
+{
+    ReplayDevice capture{capturePath, ReadTimeout};
+
+    if (!capture.open())
+    {
+        std::fprintf(stderr, "%s\n", capture.errorStr().c_str());
+        return std::nullopt;
+    }
+
+    Replay replay{false, 0, capture.records().size(), capture.duration() / 1e9, 0, 0, 0};
+
+    // Every packet is a header, the block and its CRC
+    for (auto& record : capture.records())
+    {
+        if (record.direction == CaptureDevice::TX && record.bytes.size() > 5)
+        {
+            replay.blockSize = record.bytes.size() - 5;
+            break;
+        }
+    }
+
+    if (replay.blockSize == 0)
+    {
+        std::fprintf(stderr, "Capture does not contain an upload\n");
+        return std::nullopt;
+    }
+
+    NullBuffer null;
+    std::streambuf* stderrBuffer = std::cerr.rdbuf(&null);
+
+    size_t divergences;
+    replay.success = replayUpload(capturePath, binaryPath, replay.blockSize, 1.0,
+                                  replay.replayed, replay.divergences) &&
+            replayUpload(capturePath, binaryPath, replay.blockSize, 0.0,
+                         replay.hostOnly, divergences);
+
+    std::cerr.rdbuf(stderrBuffer);
+
+    return replay;
+}
+
+void printReplay(const Replay& replay, const bool& json)
+{
+    if (json)
+    {
+        std::printf("{\n  \"version\": \"%s\",\n  \"replay\": {\n"
+                    "    \"success\": %s,\n"
+                    "    \"block_size\": %d,\n"
+                    "    \"records\": %zu,\n"
+                    "    \"captured_s\": %.6f,\n"
+                    "    \"replayed_s\": %.6f,\n"
+                    "    \"host_only_s\": %.6f,\n"
+                    "    \"divergences\": %zu\n"
+                    "  }\n}\n",
+                    VERSION, replay.success ? "true" : "false", replay.blockSize, replay.records,
+                    replay.captured, replay.replayed, replay.hostOnly, replay.divergences);
+        return;
+    }
+
+    std::printf("Replay, block size %d, %zu records\n", replay.blockSize, replay.records);
+    std::printf("Upload: %s\n", replay.success ? "succeeded" : "failed");
+    std::printf("Captured: %.6f s\n", replay.captured);
+    std::printf("Replayed: %.6f s\n", replay.replayed);
+    std::printf("Host only: %.6f s\n", replay.hostOnly);
+    std::printf("Divergences: %zu\n", replay.divergences);
+}
+
+void printText(const std::vector<Measurement>& measurements, const FaultRecovery& recovery,
+               const size_t& steadyAllocations)
+{
+    std::printf("Allocations after the handshake: %zu\n\n", steadyAllocations);
+    std::printf("Hot paths\n");
+    std::printf("%-22s %12s %12s\n", "benchmark", "ns/op", "MB/s");
+
+    for (auto& measurement : measurements)
+    {
+        if (measurement.bytesPerOp > 0)
+            std::printf("%-22s %12.1f %12.1f\n", measurement.name.c_str(), measurement.nsPerOp,
+                        measurement.bytesPerOp / measurement.nsPerOp * 1e3);
+        else
+            std::printf("%-22s %12.1f %12s\n", measurement.name.c_str(), measurement.nsPerOp, "-");
+    }
+
+    std::printf("\nXMODEM recovery, %zu byte image, block size %d, %d baud, %d ms read timeout, %llu seeds\n",
+                ImageSize, BlockSize, BaudRate, ReadTimeout,
+                static_cast<unsigned long long>(Seeds));
+    std::printf("Fault free: %.0f B/s, %.3f s\n\n", recovery.baselineThroughput, recovery.baselineElapsed);
+    std::printf("%-14s %8s %9s %11s %9s %14s\n",
+                "fault", "rate", "success", "throughput", "loss", "recovery/fault");
+
+    for (auto& result : recovery.results)
+    {
+        if (result.success == 0)
+        {
+            std::printf("%-14s %8.4f %8.0f%% %11s %9s %14s\n",
+                        result.name.data(), result.rate, 0.0, "-", "-", "-");
+            continue;
+        }
+
+        std::printf("%-14s %8.4f %8.0f%% %7.0f B/s %8.1f%% %11.1f ms\n",
+                    result.name.data(), result.rate,
+                    100.0 * result.success,
+                    result.throughput,
+                    100.0 * result.loss,
+                    result.recoveryPerFault);
+    }
+}
+
+// Stable keys, so results can be compared between releases
+void printJSON(const std::vector<Measurement>& measurements, const FaultRecovery& recovery,
+               const size_t& steadyAllocations)
+{
+    std::printf("{\n  \"version\": \"%s\",\n  \"steady_state_allocations\": %zu,\n  \"hot_paths\": [\n",
+                VERSION, steadyAllocations);
+
+    for (size_t i = 0; i < measurements.size(); i++)
+    {
+        auto& measurement = measurements[i];
+
+        std::printf("    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"bytes_per_op\": %.0f}%s\n",
+                    measurement.name.c_str(), measurement.nsPerOp, measurement.bytesPerOp,
+                    i + 1 < measurements.size() ? "," : "");
+    }
+
+    std::printf("  ],\n  \"fault_recovery\": {\n"
+                "    \"image_size\": %zu,\n"
+                "    \"block_size\": %d,\n"
+                "    \"baud_rate\": %d,\n"
+                "    \"read_timeout_ms\": %d,\n"
+                "    \"seeds\": %llu,\n"
+                "    \"baseline_throughput\": %.1f,\n"
+                "    \"scenarios\": [\n",
+                ImageSize, BlockSize, BaudRate, ReadTimeout,
+                static_cast<unsigned long long>(Seeds),
+                recovery.baselineThroughput);
+
+    for (size_t i = 0; i < recovery.results.size(); i++)
+    {
+        auto& result = recovery.results[i];
+
+        std::printf("      {\"fault\": \"%s\", \"rate\": %g, \"success\": %.3f, ",
+                    result.name.data(), result.rate, result.success);
+
+        if (result.success > 0)
+            std::printf("\"throughput\": %.1f, \"loss\": %.4f, \"recovery_ms\": %.2f}",
+                        result.throughput, result.loss, result.recoveryPerFault);
+        else
+            std::printf("\"throughput\": null, \"loss\": null, \"recovery_ms\": null}");
+
+        std::printf("%s\n", i + 1 < recovery.results.size() ? "," : "");
+    }
+
+    std::printf("    ]\n  }\n}\n");
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    bool check = false;
+    std::filesystem::path capturePath;
+    std::filesystem::path binaryPath;
+
+    for (int32_t i = 1; i < argc; i++)
+    {
+        if (std::string_view{argv[i]} == "--json")
+        {
+            json = true;
+        }
+        else if (std::string_view{argv[i]} == "--check")
+        {
+            check = true;
+        }
+        else if (std::string_view{argv[i]} == "--replay" && i + 2 < argc)
+        {
+            capturePath = argv[++i];
+            binaryPath = argv[++i];
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: vegadude_bench [--json] [--check] [--replay <capture> <binary>]\n");
+            return -1;
+        }
+    }
+
+    if (check) return runChecks() ? 0 : -1;
+
+    if (!capturePath.empty())
+    {
+        std::optional<Replay> replay = benchReplay(capturePath, binaryPath);
+        if (!replay) return -1;
+
+        printReplay(*replay, json);
+        return replay->success ? 0 : -1;
+    }
+
+    size_t steadyAllocations = benchAllocations();
+    std::vector<Measurement> measurements = benchHotPaths();
+    FaultRecovery recovery = benchFaultRecovery();
+
+    if (json)
+        printJSON(measurements, recovery, steadyAllocations);
+    else
+        printText(measurements, recovery, steadyAllocations);
+
+    // Any allocation in the loop run once per block is a regression
+    return steadyAllocations == 0 ? 0 : -1;
+}
@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "binarylogger.h"
+
+#include <cstdio>
+#include <ctime>
+
+BinaryLogger::ThreadBuffer::ThreadBuffer(const uint32_t &thread)
+    : m_thread{thread},
+      m_data{std::make_unique<unsigned char[]>(BufferSize)},
+      m_head{0},
+      m_tail{0},
+      m_dropped{0}
+{}
+
+void BinaryLogger::ThreadBuffer::push(std::span<const unsigned char> entry)
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_acquire);
+
+    if (BufferSize - (tail - head) < entry.size())
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t offset = tail % BufferSize;
+    size_t first = std::min(entry.size(), BufferSize - offset);
+
+    std::memcpy(m_data.get() + offset, entry.data(), first);
+    std::memcpy(m_data.get(), entry.data() + first, entry.size() - first);
+
+    m_tail.store(tail + entry.size(), std::memory_order_release);
+}
+
+template<typename Consumer>
+void BinaryLogger::ThreadBuffer::drain(Consumer&& consume)
+{
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+
+    std::array<unsigned char, MaxEntrySize> entry;
+
+    while (head != tail)
+    {
+        for (size_t i = 0; i < sizeof(uint16_t); i++)
+            entry[i] = m_data[(head + i) % BufferSize];
+
+        uint16_t size;
+        std::memcpy(&size, entry.data(), sizeof(size));
+
+        for (size_t i = sizeof(uint16_t); i < size; i++)
+            entry[i] = m_data[(head + i) % BufferSize];
+
+        consume(std::span<const unsigned char>{entry.data(), size});
+        head += size;
+    }
+
+    m_head.store(head, std::memory_order_release);
+}
+
+const uint32_t &BinaryLogger::ThreadBuffer::thread()
+{
+    return m_thread;
+}
+
+uint64_t BinaryLogger::ThreadBuffer::takeDropped()
+{
+    return m_dropped.exchange(0, std::memory_order_relaxed);
+}
+
+BinaryLogger::BinaryLogger()
+    : m_error{Error::NONE},
+      m_running{false},
+      m_echo{false},
+      m_stopRequested{false},
+      m_nextThread{0}
+{}
+
+BinaryLogger::~BinaryLogger()
+{
+    stop();
+}
+
+BinaryLogger &BinaryLogger::get()
+{
+    // The format registry has to outlive the logger, whose destructor may
+    // still write entries
+    formatsMutex();
+    formats();
+
+    static BinaryLogger instance;
+    return instance;
+}
+
+const BinaryLogger::Error &BinaryLogger::error()
+{
+    return m_error;
+}
+
+std::string BinaryLogger::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case ALREADY_RUNNING:
+        return "Binary logger is already running";
+    case OPEN_FAILED:
+        return "Failed to open binary log file";
+    case READ_FAILED:
+        return "Failed to read binary log file";
+    case INVALID_FORMAT:
+        return "Not a vegadude binary log file";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+std::mutex &BinaryLogger::formatsMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::deque<std::string> &BinaryLogger::formats()
+{
+    // A deque, so that strings never move while the writer reads them
+    static std::deque<std::string> formats;
+    return formats;
+}
+
+uint16_t BinaryLogger::registerFormat(std::string_view format)
+{
+    std::lock_guard lock{formatsMutex()};
+
+    formats().emplace_back(format);
+    return formats().size() - 1;
+}
+
+bool BinaryLogger::start(const std::filesystem::path &filePath, const bool &echo)
+{
+    if (m_running)
+    {
+        m_error = Error::ALREADY_RUNNING;
+        return false;
+    }
+
+    m_stream.open(filePath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+    if (m_stream.fail())
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    m_stream.write(reinterpret_cast<const char*>(Magic.data()), Magic.size());
+    m_stream.write(reinterpret_cast<const char*>(&Version), sizeof(Version));
+
+    m_echo = echo;
+    m_formatsWritten.clear();
+    m_stopRequested = false;
+    m_thread = std::thread{&BinaryLogger::run, this};
+    m_running = true;
+
+    m_error = Error::NONE;
+    return true;
+}
+
+void BinaryLogger::stop()
+{
+    if (!m_running) return;
+
+    m_running = false;
+    m_stopRequested = true;
+    m_thread.join();
+
+    m_stream.close();
+}
+
+bool BinaryLogger::running()
+{
+    return m_running;
+}
+
+BinaryLogger::ThreadBuffer &BinaryLogger::buffer()
+{
+    // Kept alive by the logger as well, so entries of a thread that already
+    // exited are still written
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+
+    if (!buffer)
+    {
+        std::lock_guard lock{m_buffersMutex};
+        buffer = std::make_shared<ThreadBuffer>(m_nextThread++);
+        m_buffers.push_back(buffer);
+    }
+
+    return *buffer;
+}
+
+void BinaryLogger::encodeString(std::array<unsigned char, MaxEntrySize> &entry, size_t &size,
+                                std::string_view value)
+{
+    value = value.substr(0, MaxStringSize);
+
+    if (size + 1 + sizeof(uint16_t) + value.size() > MaxEntrySize) return;
+
+    uint16_t length = value.size();
+
+    entry[size++] = STRING;
+    std::memcpy(entry.data() + size, &length, sizeof(length));
+    size += sizeof(length);
+    std::memcpy(entry.data() + size, value.data(), value.size());
+    size += value.size();
+}
+
+void BinaryLogger::run()
+{
+    while (!m_stopRequested)
+    {
+        drain();
+        std::this_thread::sleep_for(DrainInterval);
+    }
+
+    drain();
+}
+
+void BinaryLogger::drain()
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+    {
+        std::lock_guard lock{m_buffersMutex};
+        buffers = m_buffers;
+    }
+
+    for (auto& buffer : buffers)
+    {
+        buffer->drain([&](std::span<const unsigned char> entry) {
+            writeEntry(buffer->thread(), entry);
+        });
+
+        uint64_t dropped = buffer->takeDropped();
+
+        if (dropped > 0)
+        {
+            uint32_t thread = buffer->thread();
+
+            m_stream.put(DROPPED);
+            m_stream.write(reinterpret_cast<const char*>(&thread), sizeof(thread));
+            m_stream.write(reinterpret_cast<const char*>(&dropped), sizeof(dropped));
+
+            if (m_echo)
+                std::fprintf(stderr, "[thread %u] dropped %llu log entries\n",
+                             thread, static_cast<unsigned long long>(dropped));
+        }
+    }
+
+    m_stream.flush();
+}
+
+void BinaryLogger::writeEntry(const uint32_t &thread, std::span<const unsigned char> entry)
+{
+    uint16_t id;
+    std::memcpy(&id, entry.data() + sizeof(uint16_t), sizeof(id));
+
+    std::string_view text;
+
+    {
+        std::lock_guard lock{formatsMutex()};
+        text = formats()[id];
+    }
+
+    // Formats are written once, right before the first entry using them
+    if (m_formatsWritten.size() <= id)
+        m_formatsWritten.resize(id + 1, false);
+
+    if (!m_formatsWritten[id])
+    {
+        uint16_t length = text.size();
+
+        m_stream.put(FORMAT);
+        m_stream.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        m_stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        m_stream.write(text.data(), text.size());
+
+        m_formatsWritten[id] = true;
+    }
+
+    m_stream.put(ENTRY);
+    m_stream.write(reinterpret_cast<const char*>(&thread), sizeof(thread));
+    m_stream.write(reinterpret_cast<const char*>(entry.data()), entry.size());
+
+    // stdio rather than iostreams, which the minimal build leaves out
+    if (m_echo)
+        std::fprintf(stderr, "%s\n", format(text, entry.subspan(EntryHeaderSize)).c_str());
+}
+
+std::string BinaryLogger::format(std::string_view format, std::span<const unsigned char> args)
+{
+    std::string text;
+    size_t offset = 0;
+
+    while (true)
+    {
+        size_t placeholder = format.find("{}");
+        text.append(format.substr(0, placeholder));
+
+        if (placeholder == std::string_view::npos) break;
+
+        format.remove_prefix(placeholder + 2);
+
+        if (offset >= args.size())
+        {
+            text.append("{}");
+            continue;
+        }
+
+        ArgType type = static_cast<ArgType>(args[offset++]);
+
+        if (type == SIGNED && offset + sizeof(int64_t) <= args.size())
+        {
+            int64_t value;
+            std::memcpy(&value, args.data() + offset, sizeof(value));
+            offset += sizeof(value);
+            text.append(std::to_string(value));
+        }
+        else if (type == UNSIGNED && offset + sizeof(uint64_t) <= args.size())
+        {
+            uint64_t value;
+            std::memcpy(&value, args.data() + offset, sizeof(value));
+            offset += sizeof(value);
+            text.append(std::to_string(value));
+        }
+        else if (type == FLOATING && offset + sizeof(double) <= args.size())
+        {
+            double value;
+            std::memcpy(&value, args.data() + offset, sizeof(value));
+            offset += sizeof(value);
+
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%g", value);
+            text.append(buffer);
+        }
+        else if (type == STRING && offset + sizeof(uint16_t) <= args.size())
+        {
+            uint16_t length;
+            std::memcpy(&length, args.data() + offset, sizeof(length));
+            offset += sizeof(length);
+
+            length = std::min<size_t>(length, args.size() - offset);
+            text.append(reinterpret_cast<const char*>(args.data() + offset), length);
+            offset += length;
+        }
+        else
+        {
+            // Truncated or corrupt, nothing after this can be trusted
+            offset = args.size();
+            text.append("<?>");
+        }
+    }
+
+    return text;
+}
+
+namespace
+{
+
+template<typename T>
+bool readValue(std::ifstream& stream, T& value)
+{
+    return bool(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+std::string timestampStr(const uint64_t& timestamp)
+{
+    std::time_t seconds = timestamp / 1000000000;
+    std::tm time;
+
+#ifdef __WIN32
+    localtime_s(&time, &seconds);
+#else
+    localtime_r(&seconds, &time);
+#endif
+
+    char buffer[64];
+    size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &time);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%09llu",
+                  static_cast<unsigned long long>(timestamp % 1000000000));
+
+    return buffer;
+}
+
+}
+
+bool BinaryLogger::decode(const std::filesystem::path &filePath, std::ostream &out, Error &error)
+{
+    std::ifstream stream{filePath, std::ifstream::in | std::ifstream::binary};
+
+    if (!stream)
+    {
+        error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    std::array<unsigned char, Magic.size()> magic;
+    uint32_t version;
+
+    if (!stream.read(reinterpret_cast<char*>(magic.data()), magic.size()) ||
+            !readValue(stream, version) ||
+            magic != Magic || version != Version)
+    {
+        error = Error::INVALID_FORMAT;
+        return false;
+    }
+
+    std::vector<std::string> formats;
+    std::array<unsigned char, MaxEntrySize> entry;
+
+    while (true)
+    {
+        int type = stream.get();
+
+        if (type == std::ifstream::traits_type::eof()) break;
+
+        if (type == FORMAT)
+        {
+            uint16_t id, length;
+
+            if (!readValue(stream, id) || !readValue(stream, length)) break;
+
+            std::string text(length, '\0');
+
+            if (!stream.read(text.data(), length)) break;
+
+            if (formats.size() <= id) formats.resize(id + 1);
+            formats[id] = std::move(text);
+        }
+        else if (type == ENTRY)
+        {
+            uint32_t thread;
+            uint16_t size, id;
+            uint64_t timestamp;
+
+            if (!readValue(stream, thread) || !readValue(stream, size) ||
+                    size < EntryHeaderSize || size > MaxEntrySize)
+                break;
+
+            std::memcpy(entry.data(), &size, sizeof(size));
+
+            if (!stream.read(reinterpret_cast<char*>(entry.data() + sizeof(size)), size - sizeof(size)))
+                break;
+
+            std::memcpy(&id, entry.data() + sizeof(uint16_t), sizeof(id));
+            std::memcpy(&timestamp, entry.data() + 2 * sizeof(uint16_t), sizeof(timestamp));
+
+            out << "[" << timestampStr(timestamp) << "] [thread " << thread << "] "
+                << (id < formats.size() ? format(formats[id], std::span{entry}.subspan(EntryHeaderSize, size - EntryHeaderSize))
+                                        : "<unknown format " + std::to_string(id) + ">")
+                << '\n';
+        }
+        else if (type == DROPPED)
+        {
+            uint32_t thread;
+            uint64_t dropped;
+
+            if (!readValue(stream, thread) || !readValue(stream, dropped)) break;
+
+            out << "[thread " << thread << "] dropped " << dropped << " log entries\n";
+        }
+        else
+        {
+            error = Error::INVALID_FORMAT;
+            return false;
+        }
+    }
+
+    // A log cut short by a crash still decodes up to the last whole record
+    if (!stream.eof())
+    {
+        error = Error::READ_FAILED;
+        return false;
+    }
+
+    error = Error::NONE;
+    return true;
+}
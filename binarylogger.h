@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef BINARYLOGGER_H
+#define BINARYLOGGER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Logger for code that cannot afford to format text or make a syscall,
+// such as the transfer loop. An entry is only a format id, a timestamp and
+// the raw arguments, copied into a buffer owned by the calling thread. A
+// background thread drains every buffer, writes the entries to a binary
+// file and optionally formats them onto stderr.
+//
+// Formats use {} as placeholder for the next argument, and are registered
+// once, usually into a function local static:
+//
+//     static const uint16_t sent = BinaryLogger::registerFormat("block {}/{} sent");
+//     BinaryLogger::get().log(sent, block, noOfBlocks);
+//
+// The file starts with Magic and Version, followed by FORMAT, ENTRY and
+// DROPPED records in host byte order. vegadude_logdecode turns it into text.
+class BinaryLogger
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        ALREADY_RUNNING,
+        OPEN_FAILED,
+        READ_FAILED,
+        INVALID_FORMAT
+    };
+
+    enum ArgType : unsigned char
+    {
+        SIGNED,
+        UNSIGNED,
+        FLOATING,
+        STRING
+    };
+
+    enum RecordType : unsigned char
+    {
+        FORMAT,
+        ENTRY,
+        DROPPED
+    };
+
+    constexpr static std::array<unsigned char, 8> Magic {'V', 'D', 'L', 'O', 'G', 0, 0, 0};
+    constexpr static uint32_t Version {1};
+    constexpr static std::string_view Extension {".vdlog"};
+
+    // Per thread, entries that do not fit are dropped and counted
+    constexpr static size_t BufferSize {64 * 1024};
+    constexpr static size_t MaxEntrySize {512};
+    // Strings are cut off past this length
+    constexpr static size_t MaxStringSize {128};
+    constexpr static std::chrono::milliseconds DrainInterval {5};
+
+    static BinaryLogger& get();
+
+    const Error& error();
+    std::string errorStr();
+
+    // Writes entries to filePath, and formatted onto stderr if echo is set
+    bool start(const std::filesystem::path& filePath, const bool& echo);
+    void stop();
+
+    bool running();
+
+    static uint16_t registerFormat(std::string_view format);
+
+    template<typename... Args>
+    void log(const uint16_t& format, const Args&... args)
+    {
+        if (!m_running.load(std::memory_order_relaxed)) return;
+
+        std::array<unsigned char, MaxEntrySize> entry;
+        size_t size = EntryHeaderSize;
+
+        uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+
+        std::memcpy(entry.data() + sizeof(uint16_t), &format, sizeof(format));
+        std::memcpy(entry.data() + 2 * sizeof(uint16_t), &timestamp, sizeof(timestamp));
+
+        (encode(entry, size, args), ...);
+
+        uint16_t entrySize = size;
+        std::memcpy(entry.data(), &entrySize, sizeof(entrySize));
+
+        buffer().push({entry.data(), size});
+    }
+
+    // Turns a binary log file back into text, one line per entry
+    static bool decode(const std::filesystem::path& filePath, std::ostream& out, Error& error);
+
+    static std::string format(std::string_view format, std::span<const unsigned char> args);
+
+private:
+
+    // Single producer, single consumer ring of encoded entries
+    class ThreadBuffer
+    {
+    public:
+        ThreadBuffer(const uint32_t& thread);
+
+        void push(std::span<const unsigned char> entry);
+        // Hands every complete entry to consume and frees them afterwards
+        template<typename Consumer>
+        void drain(Consumer&& consume);
+
+        const uint32_t& thread();
+        uint64_t takeDropped();
+
+    private:
+        uint32_t m_thread;
+        std::unique_ptr<unsigned char[]> m_data;
+        std::atomic<size_t> m_head;
+        std::atomic<size_t> m_tail;
+        std::atomic<uint64_t> m_dropped;
+    };
+
+    // size, format id and timestamp
+    constexpr static size_t EntryHeaderSize {2 * sizeof(uint16_t) + sizeof(uint64_t)};
+
+    Error m_error;
+    std::atomic<bool> m_running;
+    bool m_echo;
+    std::ofstream m_stream;
+    std::thread m_thread;
+    std::atomic<bool> m_stopRequested;
+
+    std::mutex m_buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    uint32_t m_nextThread;
+
+    std::vector<bool> m_formatsWritten;
+    std::vector<unsigned char> m_pending;
+
+    BinaryLogger();
+    ~BinaryLogger();
+
+    ThreadBuffer& buffer();
+
+    void run();
+    void drain();
+    void writeEntry(const uint32_t& thread, std::span<const unsigned char> entry);
+
+    static std::mutex& formatsMutex();
+    static std::deque<std::string>& formats();
+
+    template<typename T>
+    static void encode(std::array<unsigned char, MaxEntrySize>& entry, size_t& size, const T& arg)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            encodeValue(entry, size, UNSIGNED, static_cast<uint64_t>(arg));
+        }
+        else if constexpr (std::signed_integral<T>)
+        {
+            encodeValue(entry, size, SIGNED, static_cast<int64_t>(arg));
+        }
+        else if constexpr (std::unsigned_integral<T>)
+        {
+            encodeValue(entry, size, UNSIGNED, static_cast<uint64_t>(arg));
+        }
+        else if constexpr (std::floating_point<T>)
+        {
+            encodeValue(entry, size, FLOATING, static_cast<double>(arg));
+        }
+        else
+        {
+            encodeString(entry, size, std::string_view{arg});
+        }
+    }
+
+    template<typename T>
+    static void encodeValue(std::array<unsigned char, MaxEntrySize>& entry, size_t& size,
+                            const ArgType& type, const T& value)
+    {
+        if (size + 1 + sizeof(T) > MaxEntrySize) return;
+
+        entry[size++] = type;
+        std::memcpy(entry.data() + size, &value, sizeof(T));
+        size += sizeof(T);
+    }
+
+    static void encodeString(std::array<unsigned char, MaxEntrySize>& entry, size_t& size,
+                             std::string_view value);
+};
+
+#endif // BINARYLOGGER_H
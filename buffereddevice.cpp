@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "buffereddevice.h"
+
+#include <algorithm>
+#include <cstring>
+
+BufferedDevice::BufferedDevice(Device& device)
+    : m_error{Error::NONE},
+      m_device{device},
+      m_head{0},
+      m_size{0}
+{}
+
+const BufferedDevice::Error &BufferedDevice::error()
+{
+    return m_error;
+}
+
+std::string BufferedDevice::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case READ_FAILED:
+        return "Read failed";
+    case WRITE_FAILED:
+        return "Write failed";
+    case TIMED_OUT:
+        return "Read timed out";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool BufferedDevice::fill()
+{
+    if (m_size == BufferSize) return true;
+
+    // Start from the beginning when empty so the whole buffer is
+    // available to a single read
+    if (m_size == 0) m_head = 0;
+
+    size_t tail = (m_head + m_size) % BufferSize;
+    size_t space = (tail >= m_head) ? BufferSize - tail : m_head - tail;
+
+    size_t bytesRead;
+    if (!m_device.readSome({m_buffer.data() + tail, space}, bytesRead))
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    m_size += bytesRead;
+
+    if (bytesRead == 0)
+    {
+        m_error = Error::TIMED_OUT;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+size_t BufferedDevice::take(std::span<unsigned char> bytes)
+{
+    size_t count = std::min(bytes.size(), m_size);
+    size_t first = std::min(count, BufferSize - m_head);
+
+    std::memcpy(bytes.data(), m_buffer.data() + m_head, first);
+    std::memcpy(bytes.data() + first, m_buffer.data(), count - first);
+
+    m_head = (m_head + count) % BufferSize;
+    m_size -= count;
+
+    return count;
+}
+
+bool BufferedDevice::read(std::span<unsigned char> bytes)
+{
+    size_t done = take(bytes);
+
+    while (done < bytes.size())
+    {
+        if (!fill()) return false;
+        done += take(bytes.subspan(done));
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool BufferedDevice::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_size == 0 && !fill())
+        return m_error == Error::TIMED_OUT;
+
+    bytesRead = take(bytes);
+
+    m_error = Error::NONE;
+    return true;
+}
+
+std::chrono::microseconds BufferedDevice::pendingTransmitTime()
+{
+    return m_device.pendingTransmitTime();
+}
+
+bool BufferedDevice::drain()
+{
+    if (!m_device.drain())
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool BufferedDevice::transact(std::span<const unsigned char> request,
+                              std::span<unsigned char> reply,
+                              size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    // Stale bytes are already waiting, the reply will come after them
+    if (m_size != 0)
+    {
+        if (!write(request)) return false;
+        return readSome(reply, bytesRead);
+    }
+
+    size_t received;
+    m_head = 0;
+
+    if (!m_device.transact(request, m_buffer, received))
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    m_size = received;
+    bytesRead = take(reply);
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool BufferedDevice::write(std::span<const unsigned char> bytes)
+{
+    if (m_device.write(bytes))
+    {
+        m_error = Error::NONE;
+        return true;
+    }
+    else
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+}
+
+bool BufferedDevice::peek(unsigned char* byte)
+{
+    if (m_size == 0 && !fill()) return false;
+
+    *byte = m_buffer[m_head];
+
+    m_error = Error::NONE;
+    return true;
+}
+
+size_t BufferedDevice::discard(size_t count)
+{
+    count = std::min(count, m_size);
+
+    m_head = (m_head + count) % BufferSize;
+    m_size -= count;
+
+    return count;
+}
+
+size_t BufferedDevice::discardAll()
+{
+    return discard(m_size);
+}
+
+size_t BufferedDevice::available()
+{
+    return m_size;
+}
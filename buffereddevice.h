@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef BUFFEREDDEVICE_H
+#define BUFFEREDDEVICE_H
+
+#include <array>
+#include <string>
+#include "device.h"
+
+// Wraps another device and keeps received bytes in a ring buffer, so that
+// a single read on the wrapped device pulls in everything it has available.
+class BufferedDevice : public Device
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        READ_FAILED,
+        WRITE_FAILED,
+        TIMED_OUT
+    };
+
+    constexpr static size_t BufferSize {4096};
+
+    BufferedDevice(Device& device);
+
+    const Error& error();
+    std::string errorStr();
+
+    // Fills all of bytes, fails with TIMED_OUT if the device stops sending.
+    bool read(std::span<unsigned char> bytes);
+    bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+    bool transact(std::span<const unsigned char> request,
+                  std::span<unsigned char> reply,
+                  size_t& bytesRead);
+
+    std::chrono::microseconds pendingTransmitTime();
+    bool drain();
+
+    // Looks at the next received byte without consuming it.
+    bool peek(unsigned char* byte);
+
+    // Drops up to count buffered bytes, returns how many were dropped.
+    size_t discard(size_t count);
+    size_t discardAll();
+
+    size_t available();
+
+private:
+    Error m_error;
+    Device& m_device;
+
+    std::array<unsigned char, BufferSize> m_buffer;
+    size_t m_head;
+    size_t m_size;
+
+    bool fill();
+    size_t take(std::span<unsigned char> bytes);
+};
+
+#endif // BUFFEREDDEVICE_H
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "capturedevice.h"
+
+#include <algorithm>
+#include <cstring>
+
+CaptureDevice::CaptureDevice(Device &device)
+    : m_device{device},
+      m_error{Error::NONE},
+      m_stopRequested{false},
+      m_failed{false},
+      m_open{false},
+      m_head{0},
+      m_tail{0},
+      m_position{0}
+{}
+
+CaptureDevice::~CaptureDevice()
+{
+    close();
+}
+
+const CaptureDevice::Error &CaptureDevice::error()
+{
+    return m_error;
+}
+
+std::string CaptureDevice::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case ALREADY_OPEN:
+        return "Capture is already open";
+    case OPEN_FAILED:
+        return "Failed to open capture file";
+    case WRITE_FAILED:
+        return "Failed to write capture file";
+    case READ_FAILED:
+        return "Failed to read capture file";
+    case INVALID_FORMAT:
+        return "Not a vegadude capture file";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool CaptureDevice::open(const std::filesystem::path &filePath)
+{
+    if (m_open)
+    {
+        m_error = Error::ALREADY_OPEN;
+        return false;
+    }
+
+    m_stream.open(filePath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+    if (m_stream.fail())
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    m_stream.write(reinterpret_cast<const char*>(Magic.data()), Magic.size());
+    m_stream.write(reinterpret_cast<const char*>(&Version), sizeof(Version));
+
+    if (!m_data)
+        m_data = std::make_unique<unsigned char[]>(RingSize);
+
+    m_head = 0;
+    m_tail = 0;
+    m_position = 0;
+    m_failed = false;
+    m_stopRequested = false;
+    m_start = std::chrono::steady_clock::now();
+    m_thread = std::thread{&CaptureDevice::run, this};
+    m_open = true;
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool CaptureDevice::close()
+{
+    if (!m_open) return true;
+
+    m_open = false;
+    m_stopRequested = true;
+    m_thread.join();
+
+    m_stream.close();
+
+    if (m_failed || m_stream.fail())
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool CaptureDevice::read(std::span<unsigned char> bytes)
+{
+    // Goes through readSome so that only what actually arrived is recorded
+    size_t filled = 0;
+
+    while (filled < bytes.size())
+    {
+        size_t bytesRead;
+        if (!readSome(bytes.subspan(filled), bytesRead)) return false;
+        if (bytesRead == 0) break;
+
+        filled += bytesRead;
+    }
+
+    return true;
+}
+
+bool CaptureDevice::readSome(std::span<unsigned char> bytes, size_t &bytesRead)
+{
+    if (!m_device.readSome(bytes, bytesRead)) return false;
+
+    if (bytesRead > 0)
+        record(RX, std::chrono::steady_clock::now(), bytes.first(bytesRead));
+
+    return true;
+}
+
+bool CaptureDevice::write(std::span<const unsigned char> bytes)
+{
+    auto time = std::chrono::steady_clock::now();
+
+    if (!m_device.write(bytes)) return false;
+
+    record(TX, time, bytes);
+    return true;
+}
+
+std::chrono::microseconds CaptureDevice::pendingTransmitTime()
+{
+    return m_device.pendingTransmitTime();
+}
+
+bool CaptureDevice::drain()
+{
+    return m_device.drain();
+}
+
+void CaptureDevice::record(const Direction &direction,
+                           const std::chrono::steady_clock::time_point &time,
+                           std::span<const unsigned char> bytes)
+{
+    if (!m_open) return;
+
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_start).count();
+
+    // A record has to fit into the ring as a whole
+    constexpr size_t maxRecordBytes = RingSize / 2;
+
+    while (!bytes.empty())
+    {
+        std::span<const unsigned char> chunk = bytes.first(std::min(bytes.size(), maxRecordBytes));
+        bytes = bytes.subspan(chunk.size());
+
+        std::array<unsigned char, RecordHeaderSize> header;
+        uint32_t length = chunk.size();
+
+        header[0] = direction;
+        std::memcpy(header.data() + 1, &timestamp, sizeof(timestamp));
+        std::memcpy(header.data() + 1 + sizeof(timestamp), &length, sizeof(length));
+
+        size_t size = header.size() + chunk.size();
+
+        while (RingSize - (m_position - m_head.load(std::memory_order_acquire)) < size)
+        {
+            if (m_failed) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        push(header);
+        push(chunk);
+
+        // The writer only ever sees whole records
+        m_tail.store(m_position, std::memory_order_release);
+    }
+}
+
+void CaptureDevice::push(std::span<const unsigned char> bytes)
+{
+    size_t offset = m_position % RingSize;
+    size_t first = std::min(bytes.size(), RingSize - offset);
+
+    std::memcpy(m_data.get() + offset, bytes.data(), first);
+    std::memcpy(m_data.get(), bytes.data() + first, bytes.size() - first);
+
+    m_position += bytes.size();
+}
+
+void CaptureDevice::run()
+{
+    while (!m_stopRequested)
+    {
+        writeRing();
+        std::this_thread::sleep_for(DrainInterval);
+    }
+
+    writeRing();
+}
+
+void CaptureDevice::writeRing()
+{
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+
+    if (head == tail) return;
+
+    size_t offset = head % RingSize;
+    size_t first = std::min(tail - head, RingSize - offset);
+
+    m_stream.write(reinterpret_cast<const char*>(m_data.get() + offset), first);
+    m_stream.write(reinterpret_cast<const char*>(m_data.get()), tail - head - first);
+    m_stream.flush();
+
+    // Reported by close(), the ring keeps draining so record() never stalls
+    if (m_stream.fail()) m_failed = true;
+
+    m_head.store(tail, std::memory_order_release);
+}
+
+namespace
+{
+
+template<typename T>
+bool readValue(std::ifstream& stream, T& value)
+{
+    return bool(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+}
+
+bool CaptureDevice::load(const std::filesystem::path &filePath, std::vector<Record> &records, Error &error)
+{
+    std::ifstream stream{filePath, std::ifstream::in | std::ifstream::binary};
+
+    if (stream.fail())
+    {
+        error = Error::READ_FAILED;
+        return false;
+    }
+
+    std::array<unsigned char, Magic.size()> magic;
+    uint32_t version;
+
+    if (!stream.read(reinterpret_cast<char*>(magic.data()), magic.size()) ||
+            magic != Magic ||
+            !readValue(stream, version) ||
+            version != Version)
+    {
+        error = Error::INVALID_FORMAT;
+        return false;
+    }
+
+    records.clear();
+
+    unsigned char direction;
+
+    while (readValue(stream, direction))
+    {
+        Record record;
+        uint32_t length;
+
+        if (direction > TX ||
+                !readValue(stream, record.timestamp) ||
+                !readValue(stream, length))
+        {
+            error = Error::INVALID_FORMAT;
+            return false;
+        }
+
+        record.direction = static_cast<Direction>(direction);
+        record.bytes.resize(length);
+
+        if (!stream.read(reinterpret_cast<char*>(record.bytes.data()), length))
+        {
+            error = Error::INVALID_FORMAT;
+            return false;
+        }
+
+        records.push_back(std::move(record));
+    }
+
+    error = Error::NONE;
+    return true;
+}
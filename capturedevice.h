@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef CAPTUREDEVICE_H
+#define CAPTUREDEVICE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "device.h"
+
+// Wraps another device and records every byte going through it, with the
+// time it was seen, into a capture file. Records are copied into a ring
+// allocated by open() and written to the file by a background thread, so
+// the caller never waits on the disk. Only if the writer falls a whole
+// ring behind does the caller wait for it.
+//
+// The file starts with Magic and Version, followed by records of a
+// direction, a timestamp in nanoseconds since the capture was opened, a
+// length and the bytes, all in host byte order. ReplayDevice plays the
+// target's side of a capture back.
+class CaptureDevice : public Device
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        ALREADY_OPEN,
+        OPEN_FAILED,
+        WRITE_FAILED,
+        READ_FAILED,
+        INVALID_FORMAT
+    };
+
+    enum Direction : unsigned char
+    {
+        // Target to host
+        RX,
+        // Host to target
+        TX
+    };
+
+    struct Record
+    {
+        Direction direction;
+        uint64_t timestamp;
+        std::vector<unsigned char> bytes;
+    };
+
+    constexpr static std::array<unsigned char, 8> Magic {'V', 'D', 'C', 'A', 'P', 0, 0, 0};
+    constexpr static uint32_t Version {1};
+    constexpr static std::string_view Extension {".vdcap"};
+
+    constexpr static size_t RingSize {1024 * 1024};
+    constexpr static std::chrono::milliseconds DrainInterval {5};
+
+    CaptureDevice(Device& device);
+    ~CaptureDevice();
+
+    const Error& error();
+    std::string errorStr();
+
+    bool open(const std::filesystem::path& filePath);
+    // Waits for every record to reach the file
+    bool close();
+
+    bool read(std::span<unsigned char> bytes);
+    bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    std::chrono::microseconds pendingTransmitTime();
+    bool drain();
+
+    static bool load(const std::filesystem::path& filePath, std::vector<Record>& records, Error& error);
+
+private:
+    // direction, timestamp and length
+    constexpr static size_t RecordHeaderSize {1 + sizeof(uint64_t) + sizeof(uint32_t)};
+
+    Device& m_device;
+    Error m_error;
+    std::ofstream m_stream;
+    std::thread m_thread;
+    std::atomic<bool> m_stopRequested;
+    std::atomic<bool> m_failed;
+    bool m_open;
+
+    std::chrono::steady_clock::time_point m_start;
+
+    // Single producer, single consumer
+    std::unique_ptr<unsigned char[]> m_data;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    // Where the next record goes, published to the writer through m_tail
+    size_t m_position;
+
+    void record(const Direction& direction,
+                const std::chrono::steady_clock::time_point& time,
+                std::span<const unsigned char> bytes);
+    void push(std::span<const unsigned char> bytes);
+
+    void run();
+    void writeRing();
+};
+
+#endif // CAPTUREDEVICE_H
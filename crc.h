@@ -14,6 +14,8 @@
 #ifndef CRC_H
 #define CRC_H
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 #include <span>
@@ -55,6 +57,53 @@ constexpr static uint16_t CRC16CCITTable[] = {
     0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
     0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
     0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0};
+
+// CRC16CCITTSlices[k][b] is the CRC of byte b followed by k zero bytes,
+// which lets eight bytes be folded in at once
+constexpr std::array<std::array<uint16_t, 256>, 8> generateCRC16CCITTSlices()
+{
+    std::array<std::array<uint16_t, 256>, 8> slices {};
+
+    for (size_t byte = 0; byte < 256; byte++)
+        slices[0][byte] = CRC16CCITTable[byte];
+
+    for (size_t k = 1; k < slices.size(); k++)
+        for (size_t byte = 0; byte < 256; byte++)
+            slices[k][byte] = (slices[k - 1][byte] << 8) ^ CRC16CCITTable[slices[k - 1][byte] >> 8];
+
+    return slices;
+}
+
+constexpr static std::array<std::array<uint16_t, 256>, 8> CRC16CCITTSlices = generateCRC16CCITTSlices();
+
+// Same as generateCRC16CCITT for a length known at compile time. The loop
+// over eight byte slices has no remainder to handle for the usual block
+// sizes, and can be unrolled.
+template<size_t Size>
+constexpr uint16_t generateCRC16CCITT(std::span<const unsigned char, Size> bytes)
+{
+    static_assert(Size != std::dynamic_extent);
+
+    uint16_t result = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= Size; i += 8)
+    {
+        result = CRC16CCITTSlices[7][(result >> 8) ^ bytes[i]] ^
+                 CRC16CCITTSlices[6][(result & 0xff) ^ bytes[i + 1]] ^
+                 CRC16CCITTSlices[5][bytes[i + 2]] ^
+                 CRC16CCITTSlices[4][bytes[i + 3]] ^
+                 CRC16CCITTSlices[3][bytes[i + 4]] ^
+                 CRC16CCITTSlices[2][bytes[i + 5]] ^
+                 CRC16CCITTSlices[1][bytes[i + 6]] ^
+                 CRC16CCITTSlices[0][bytes[i + 7]];
+    }
+
+    for (; i < Size; i++)
+        result = (result << 8) ^ CRC16CCITTable[((result >> 8) ^ bytes[i]) & 0xff];
+
+    return result;
+}
 }
 
 #endif // CRC_H
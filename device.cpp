@@ -1,5 +1,34 @@
 #include "device.h"
 
+bool Device::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+    if (!read(bytes)) return false;
+
+    bytesRead = bytes.size();
+    return true;
+}
+
+bool Device::transact(std::span<const unsigned char> request,
+                      std::span<unsigned char> reply,
+                      size_t& bytesRead)
+{
+    bytesRead = 0;
+    if (!write(request)) return false;
+
+    return readSome(reply, bytesRead);
+}
+
+std::chrono::microseconds Device::pendingTransmitTime()
+{
+    return std::chrono::microseconds{0};
+}
+
+bool Device::drain()
+{
+    return true;
+}
+
 bool Device::read(unsigned char* byte)
 {
     return read({byte, 1});
@@ -9,4 +38,3 @@ bool Device::write(const unsigned char* byte)
 {
     return write({byte, 1});
 }
-
@@ -2,14 +2,35 @@
 #define DEVICE_H
 
 #include <span>
+#include <cstddef>
+#include <chrono>
 
 class Device
 {
 public:
 
+    virtual ~Device() = default;
+
     virtual bool read(std::span<unsigned char> bytes) = 0;
     virtual bool write(std::span<const unsigned char> bytes) = 0;
 
+    // Reads at most bytes.size() bytes, stopping at whatever the device has
+    // available. bytesRead is set to 0 if the read timed out.
+    virtual bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    // Writes request and then reads the reply with readSome. Devices that
+    // can queue both operations at once should override this.
+    virtual bool transact(std::span<const unsigned char> request,
+                          std::span<unsigned char> reply,
+                          size_t& bytesRead);
+
+    // Time left until every byte written so far has been transmitted.
+    // Devices without a transmit queue of their own report 0.
+    virtual std::chrono::microseconds pendingTransmitTime();
+
+    // Blocks until every byte written so far has been transmitted
+    virtual bool drain();
+
     bool read(unsigned char* byte);
     bool write(const unsigned char* byte);
 };
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "eventloop.h"
+
+#ifdef __linux
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+EventLoop::Waiter::Waiter(EventLoop& loop,
+                          const int32_t& fd,
+                          const uint32_t& events,
+                          const int32_t& timeout)
+    : m_loop{loop},
+      m_fd{fd},
+      m_events{events},
+      m_timeout{timeout},
+      m_ready{false},
+      m_failed{false}
+{}
+
+bool EventLoop::Waiter::await_ready() noexcept
+{
+    return false;
+}
+
+bool EventLoop::Waiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_handle = handle;
+    m_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout);
+
+    // Not suspending resumes the coroutine straight away with m_ready unset
+    m_failed = !m_loop.arm(this);
+    return !m_failed;
+}
+
+bool EventLoop::Waiter::await_resume() noexcept
+{
+    return m_ready;
+}
+
+bool EventLoop::Waiter::failed() const
+{
+    return m_failed;
+}
+
+EventLoop::EventLoop()
+    : m_error{Error::NONE},
+      m_epollFD{-1}
+{}
+
+EventLoop::~EventLoop()
+{
+    if (m_epollFD != -1)
+        ::close(m_epollFD);
+}
+
+const EventLoop::Error &EventLoop::error()
+{
+    return m_error;
+}
+
+std::string EventLoop::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case SETUP_FAILED:
+        return "Failed to create epoll instance";
+    case REGISTER_FAILED:
+        return "Failed to watch file descriptor";
+    case WAIT_FAILED:
+        return "epoll_wait failed";
+    case NOT_SETUP:
+        return "Event loop not setup";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool EventLoop::setup()
+{
+    m_epollFD = epoll_create1(EPOLL_CLOEXEC);
+
+    if (m_epollFD < 0)
+    {
+        m_epollFD = -1;
+        m_error = Error::SETUP_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+EventLoop::Waiter EventLoop::readable(const int32_t& fd, const int32_t& timeout)
+{
+    return Waiter{*this, fd, EPOLLIN, timeout};
+}
+
+EventLoop::Waiter EventLoop::writable(const int32_t& fd, const int32_t& timeout)
+{
+    return Waiter{*this, fd, EPOLLOUT, timeout};
+}
+
+bool EventLoop::arm(Waiter* waiter)
+{
+    if (m_epollFD == -1)
+    {
+        m_error = Error::NOT_SETUP;
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = waiter->m_events | EPOLLONESHOT;
+    event.data.fd = waiter->m_fd;
+
+    // One shot registrations stay in the set after firing and only need re-arming
+    bool registered = std::find(m_registered.begin(), m_registered.end(), waiter->m_fd) != m_registered.end();
+
+    if (epoll_ctl(m_epollFD, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, waiter->m_fd, &event) < 0)
+    {
+        m_error = Error::REGISTER_FAILED;
+        return false;
+    }
+
+    if (!registered)
+        m_registered.push_back(waiter->m_fd);
+
+    m_waiters[waiter->m_fd] = waiter;
+    return true;
+}
+
+void EventLoop::spawn(Task<bool>& task)
+{
+    task.start();
+}
+
+bool EventLoop::run()
+{
+    std::array<epoll_event, 64> events;
+    std::vector<Waiter*> resumable;
+
+    while (!m_waiters.empty())
+    {
+        auto now = std::chrono::steady_clock::now();
+        int32_t timeout = -1;
+
+        for (auto& [fd, waiter] : m_waiters)
+        {
+            if (waiter->m_timeout < 0) continue;
+
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(waiter->m_deadline - now).count();
+            remaining = std::max<int64_t>(remaining, 0);
+
+            if (timeout == -1 || remaining < timeout)
+                timeout = remaining;
+        }
+
+        int32_t count = epoll_wait(m_epollFD, events.data(), events.size(), timeout);
+
+        if (count < 0)
+        {
+            if (errno == EINTR) continue;
+
+            m_error = Error::WAIT_FAILED;
+            return false;
+        }
+
+        for (int32_t i = 0; i < count; i++)
+        {
+            auto waiter = m_waiters.find(events[i].data.fd);
+            if (waiter == m_waiters.end()) continue;
+
+            waiter->second->m_ready = true;
+            resumable.push_back(waiter->second);
+            m_waiters.erase(waiter);
+        }
+
+        now = std::chrono::steady_clock::now();
+
+        for (auto waiter = m_waiters.begin(); waiter != m_waiters.end();)
+        {
+            if (waiter->second->m_timeout >= 0 && waiter->second->m_deadline <= now)
+            {
+                resumable.push_back(waiter->second);
+                waiter = m_waiters.erase(waiter);
+            }
+            else
+            {
+                waiter++;
+            }
+        }
+
+        // Resumed coroutines may start waiting again, so resume only
+        // after the waiter set is consistent
+        for (auto waiter : resumable)
+            waiter->m_handle.resume();
+
+        resumable.clear();
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+#endif
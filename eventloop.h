@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#ifdef __linux
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "task.h"
+
+// Single threaded epoll loop resuming coroutines waiting on file descriptors.
+class EventLoop
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        SETUP_FAILED,
+        REGISTER_FAILED,
+        WAIT_FAILED,
+        NOT_SETUP
+    };
+
+    class Waiter
+    {
+    public:
+        Waiter(EventLoop& loop,
+               const int32_t& fd,
+               const uint32_t& events,
+               const int32_t& timeout);
+
+        bool await_ready() noexcept;
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        // false if the timeout passed or the descriptor could not be watched
+        bool await_resume() noexcept;
+
+        // Tells the two apart once resumed
+        bool failed() const;
+
+    private:
+        friend class EventLoop;
+
+        EventLoop& m_loop;
+        int32_t m_fd;
+        uint32_t m_events;
+        int32_t m_timeout;
+        std::chrono::steady_clock::time_point m_deadline;
+        std::coroutine_handle<> m_handle;
+        bool m_ready;
+        bool m_failed;
+    };
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    const Error& error();
+    std::string errorStr();
+
+    bool setup();
+
+    // Timeouts are in milliseconds, negative waits forever
+    Waiter readable(const int32_t& fd, const int32_t& timeout);
+    Waiter writable(const int32_t& fd, const int32_t& timeout);
+
+    // Starts task, it is driven to completion by run()
+    void spawn(Task<bool>& task);
+
+    // Returns once no coroutine is waiting anymore
+    bool run();
+
+private:
+    Error m_error;
+    int32_t m_epollFD;
+    std::unordered_map<int32_t, Waiter*> m_waiters;
+    std::vector<int32_t> m_registered;
+
+    bool arm(Waiter* waiter);
+};
+
+#endif
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "faultdevice.h"
+#include "xmodem.h"
+
+#include <algorithm>
+
+size_t FaultDevice::Stats::total() const
+{
+    return bitFlips + drops + duplicateAcks + delays + spuriousCs + spuriousCans + noise;
+}
+
+FaultDevice::FaultDevice(Device& device,
+                         const Faults& faults,
+                         const uint64_t& seed)
+    : m_device{device},
+      m_faults{faults},
+      m_random{seed},
+      m_chance{0.0, 1.0}
+{}
+
+bool FaultDevice::happens(const double& probability)
+{
+    return probability > 0 && m_chance(m_random) < probability;
+}
+
+bool FaultDevice::corrupt(unsigned char& byte)
+{
+    if (happens(m_faults.drop))
+    {
+        m_stats.drops++;
+        return false;
+    }
+
+    if (happens(m_faults.bitFlip))
+    {
+        byte ^= 1 << (m_random() % 8);
+        m_stats.bitFlips++;
+    }
+
+    return true;
+}
+
+bool FaultDevice::read(std::span<unsigned char> bytes)
+{
+    size_t bytesRead;
+    return readSome(bytes, bytesRead);
+}
+
+bool FaultDevice::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_held.empty())
+    {
+        if (happens(m_faults.spuriousC))
+        {
+            m_held.push_back(XModem::C);
+            m_stats.spuriousCs++;
+        }
+        else if (happens(m_faults.spuriousCan))
+        {
+            m_held.push_back(XModem::CAN);
+            m_stats.spuriousCans++;
+        }
+        else
+        {
+            m_scratch.resize(bytes.size());
+
+            size_t received;
+            if (!m_device.readSome(m_scratch, received)) return false;
+
+            for (size_t i = 0; i < received; i++)
+            {
+                unsigned char byte = m_scratch[i];
+                if (!corrupt(byte)) continue;
+
+                m_held.push_back(byte);
+
+                if (byte == XModem::ACK && happens(m_faults.duplicateAck))
+                {
+                    m_held.push_back(byte);
+                    m_stats.duplicateAcks++;
+                }
+            }
+
+            // The reply shows up one read later, the caller sees a timeout
+            if (!m_held.empty() && happens(m_faults.delay))
+            {
+                m_stats.delays++;
+                return true;
+            }
+
+            // Lower case only, so it is never mistaken for a protocol byte
+            if (happens(m_faults.noise))
+            {
+                m_held.push_back('a' + m_random() % 26);
+                m_stats.noise++;
+            }
+        }
+    }
+
+    bytesRead = std::min(bytes.size(), m_held.size());
+    std::copy_n(m_held.begin(), bytesRead, bytes.begin());
+    m_held.erase(m_held.begin(), m_held.begin() + bytesRead);
+
+    return true;
+}
+
+bool FaultDevice::write(std::span<const unsigned char> bytes)
+{
+    m_scratch.clear();
+
+    for (unsigned char byte : bytes)
+        if (corrupt(byte)) m_scratch.push_back(byte);
+
+    return m_device.write(m_scratch);
+}
+
+std::chrono::microseconds FaultDevice::pendingTransmitTime()
+{
+    return m_device.pendingTransmitTime();
+}
+
+bool FaultDevice::drain()
+{
+    return m_device.drain();
+}
+
+const FaultDevice::Stats &FaultDevice::stats()
+{
+    return m_stats;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef FAULTDEVICE_H
+#define FAULTDEVICE_H
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "device.h"
+
+// Wraps another device and corrupts the traffic going through it.
+// Faults are drawn from a seeded generator, so a run can be reproduced.
+class FaultDevice : public Device
+{
+public:
+
+    // Probabilities between 0 and 1
+    struct Faults
+    {
+        double bitFlip = 0;         // per byte, either direction
+        double drop = 0;            // per byte, either direction
+        double duplicateAck = 0;    // per ACK received
+        double delay = 0;           // per read, held back until the next read
+        double spuriousC = 0;       // per read
+        double spuriousCan = 0;     // per read
+        double noise = 0;           // per read, a stray letter such as boot log output
+    };
+
+    struct Stats
+    {
+        size_t bitFlips = 0;
+        size_t drops = 0;
+        size_t duplicateAcks = 0;
+        size_t delays = 0;
+        size_t spuriousCs = 0;
+        size_t spuriousCans = 0;
+        size_t noise = 0;
+
+        size_t total() const;
+    };
+
+    FaultDevice(Device& device,
+                const Faults& faults,
+                const uint64_t& seed);
+
+    bool read(std::span<unsigned char> bytes);
+    bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    std::chrono::microseconds pendingTransmitTime();
+    bool drain();
+
+    const Stats& stats();
+
+private:
+    Device& m_device;
+    Faults m_faults;
+    Stats m_stats;
+
+    std::mt19937_64 m_random;
+    std::uniform_real_distribution<double> m_chance;
+
+    std::deque<unsigned char> m_held;
+    std::vector<unsigned char> m_scratch;
+
+    bool happens(const double& probability);
+    bool corrupt(unsigned char& byte);
+};
+
+#endif // FAULTDEVICE_H
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "filewatcher.h"
+#include "packetfile.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+
+#ifdef __linux
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher()
+    : m_error{Error::NONE},
+      m_fd{-1},
+      m_stopRequested{false},
+      m_hash{0},
+      m_hashed{false}
+{}
+
+const FileWatcher::Error &FileWatcher::error()
+{
+    return m_error;
+}
+
+std::string FileWatcher::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case SETUP_FAILED:
+        return "Failed to watch the directory of the file";
+    case POLL_FAILED:
+        return "Failed to wait for file changes";
+    case READ_FAILED:
+        return "Failed to read file change events";
+    case NOT_SUPPORTED:
+        return "Watching files is only supported on Linux";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+void FileWatcher::stop()
+{
+    m_stopRequested = true;
+}
+
+const std::chrono::steady_clock::time_point &FileWatcher::lastChange()
+{
+    return m_lastChange;
+}
+
+#ifdef __linux
+
+FileWatcher::~FileWatcher()
+{
+    if (m_fd != -1) ::close(m_fd);
+}
+
+bool FileWatcher::setup(const std::filesystem::path &filePath)
+{
+    m_filePath = filePath;
+    m_fileName = filePath.filename().string();
+    m_stopRequested = false;
+
+    std::filesystem::path directory = filePath.parent_path();
+    if (directory.empty()) directory = ".";
+
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (m_fd == -1 ||
+            inotify_add_watch(m_fd, directory.c_str(),
+                              IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        m_error = Error::SETUP_FAILED;
+        return false;
+    }
+
+    // Whatever is there now was uploaded already
+    m_hashed = hash(m_hash);
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool FileWatcher::wait()
+{
+    using namespace std::chrono;
+
+    bool pending = false;
+
+    while (!m_stopRequested)
+    {
+        milliseconds timeout = StopInterval;
+
+        if (pending)
+        {
+            auto quiet = steady_clock::now() - m_lastChange;
+
+            if (quiet >= DebounceInterval)
+            {
+                pending = false;
+
+                // Vanished in the middle of being replaced, the rename follows
+                uint64_t current;
+                if (!hash(current)) continue;
+
+                if (m_hashed && current == m_hash)
+                {
+                    Logger::get() << m_filePath << " rewritten without changes, skipped." << Logger::NewLine;
+                    continue;
+                }
+
+                m_hash = current;
+                m_hashed = true;
+
+                m_error = Error::NONE;
+                return true;
+            }
+
+            timeout = std::min(timeout, ceil<milliseconds>(DebounceInterval - quiet));
+        }
+
+        pollfd fd {m_fd, POLLIN, 0};
+        int result = poll(&fd, 1, timeout.count());
+
+        if (result == -1)
+        {
+            if (errno == EINTR) continue;
+
+            m_error = Error::POLL_FAILED;
+            return false;
+        }
+
+        if (result == 0) continue;
+
+        bool changed = false;
+        if (!readEvents(changed)) return false;
+
+        if (changed)
+        {
+            pending = true;
+            m_lastChange = steady_clock::now();
+        }
+    }
+
+    m_error = Error::NONE;
+    return false;
+}
+
+bool FileWatcher::readEvents(bool &changed)
+{
+    alignas(inotify_event) char buffer[4096];
+
+    while (true)
+    {
+        ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+
+        if (length == -1)
+        {
+            if (errno == EAGAIN) return true;
+            if (errno == EINTR) continue;
+
+            m_error = Error::READ_FAILED;
+            return false;
+        }
+
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+
+            // Events were lost, the file may be among them
+            if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && m_fileName == event->name))
+                changed = true;
+
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+bool FileWatcher::hash(uint64_t &hash)
+{
+    int fd = ::open(m_filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    std::vector<unsigned char> data;
+    unsigned char chunk[65536];
+    ssize_t count;
+
+    while ((count = ::read(fd, chunk, sizeof(chunk))) > 0)
+        data.insert(data.end(), chunk, chunk + count);
+
+    ::close(fd);
+
+    if (count == -1) return false;
+
+    hash = PacketFile::generateHash(data);
+    return true;
+}
+
+#else
+
+FileWatcher::~FileWatcher()
+{}
+
+bool FileWatcher::setup(const std::filesystem::path&)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool FileWatcher::wait()
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool FileWatcher::readEvents(bool&)
+{
+    return false;
+}
+
+bool FileWatcher::hash(uint64_t&)
+{
+    return false;
+}
+
+#endif
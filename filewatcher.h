@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Waits for a file to be rewritten with new content (Linux only).
+//
+// The directory is watched with inotify rather than the file itself, so a
+// file replaced through a rename is followed as well. Once a change is
+// seen, wait() holds on until nothing has written to the file for
+// DebounceInterval, so a linker writing in several steps causes only one
+// wake up. Rewrites that leave the content as it was are ignored.
+class FileWatcher
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        SETUP_FAILED,
+        POLL_FAILED,
+        READ_FAILED,
+        NOT_SUPPORTED
+    };
+
+    constexpr static std::chrono::milliseconds DebounceInterval {100};
+    // How often stop() is checked for while waiting
+    constexpr static std::chrono::milliseconds StopInterval {100};
+
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    const Error& error();
+    std::string errorStr();
+
+    bool setup(const std::filesystem::path& filePath);
+
+    // Returns true once the file has new content. Returns false if stop()
+    // was called, or with an error set if watching failed.
+    bool wait();
+
+    // Safe to call from a signal handler
+    void stop();
+
+    // When the file was last written to before wait() returned
+    const std::chrono::steady_clock::time_point& lastChange();
+
+private:
+    Error m_error;
+    int32_t m_fd;
+    std::filesystem::path m_filePath;
+    std::string m_fileName;
+    std::atomic<bool> m_stopRequested;
+    uint64_t m_hash;
+    bool m_hashed;
+    std::chrono::steady_clock::time_point m_lastChange;
+
+    bool readEvents(bool& changed);
+    bool hash(uint64_t& hash);
+};
+
+#endif // FILEWATCHER_H
@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "iouring.h"
+
+#ifdef __linux
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+IOUring::IOUring(const uint32_t& entries)
+    : m_error{Error::NONE},
+      m_entries{entries},
+      m_fd{-1},
+      m_sqRing{MAP_FAILED},
+      m_cqRing{MAP_FAILED},
+      m_sqRingSize{0},
+      m_cqRingSize{0},
+      m_sqes{nullptr},
+      m_sqesSize{0},
+      m_toSubmit{0},
+      m_inFlight{0}
+{}
+
+IOUring::~IOUring()
+{
+    if (m_sqes != nullptr)
+        munmap(m_sqes, m_sqesSize);
+
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+
+    if (m_sqRing != MAP_FAILED)
+        munmap(m_sqRing, m_sqRingSize);
+
+    if (m_fd != -1)
+        ::close(m_fd);
+}
+
+const IOUring::Error &IOUring::error()
+{
+    return m_error;
+}
+
+std::string IOUring::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case SETUP_FAILED:
+        return "Failed to setup io_uring";
+    case MMAP_FAILED:
+        return "Failed to map io_uring queues";
+    case QUEUE_FULL:
+        return "io_uring submission queue full";
+    case ENTER_FAILED:
+        return "io_uring_enter failed";
+    case NOT_SETUP:
+        return "io_uring not setup";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool IOUring::setup()
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    m_fd = syscall(__NR_io_uring_setup, m_entries, &params);
+
+    if (m_fd < 0)
+    {
+        m_fd = -1;
+        m_error = Error::SETUP_FAILED;
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Both rings share one mapping on newer kernels
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        m_sqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        m_cqRingSize = m_sqRingSize;
+    }
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+
+    if (m_sqRing == MAP_FAILED)
+    {
+        m_error = Error::MMAP_FAILED;
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        m_cqRing = m_sqRing;
+    }
+    else
+    {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+
+        if (m_cqRing == MAP_FAILED)
+        {
+            m_error = Error::MMAP_FAILED;
+            return false;
+        }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED)
+    {
+        m_error = Error::MMAP_FAILED;
+        return false;
+    }
+
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<unsigned char*>(m_sqRing);
+    m_sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+    auto* cq = static_cast<unsigned char*>(m_cqRing);
+    m_cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    m_error = Error::NONE;
+    return true;
+}
+
+io_uring_sqe* IOUring::prepare(Request* request)
+{
+    if (m_fd == -1)
+    {
+        m_error = Error::NOT_SETUP;
+        return nullptr;
+    }
+
+    uint32_t head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    uint32_t tail = *m_sqTail;
+
+    if (tail - head >= m_entries)
+    {
+        m_error = Error::QUEUE_FULL;
+        return nullptr;
+    }
+
+    uint32_t index = tail & *m_sqMask;
+    io_uring_sqe* sqe = &m_sqes[index];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+
+    if (request != nullptr)
+    {
+        request->complete = false;
+        m_inFlight++;
+    }
+
+    m_sqArray[index] = index;
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    m_toSubmit++;
+
+    m_error = Error::NONE;
+    return sqe;
+}
+
+bool IOUring::enter(uint32_t minComplete)
+{
+    while (true)
+    {
+        int32_t result = syscall(__NR_io_uring_enter, m_fd, m_toSubmit, minComplete,
+                                 minComplete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                                 nullptr, 0);
+
+        if (result >= 0)
+        {
+            m_toSubmit -= std::min<uint32_t>(result, m_toSubmit);
+            m_error = Error::NONE;
+            return true;
+        }
+
+        if (errno != EINTR)
+        {
+            m_error = Error::ENTER_FAILED;
+            return false;
+        }
+    }
+}
+
+bool IOUring::submit()
+{
+    if (m_toSubmit == 0) return true;
+    return enter(0);
+}
+
+void IOUring::reap()
+{
+    uint32_t head = *m_cqHead;
+    uint32_t tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++)
+    {
+        io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+        auto* request = reinterpret_cast<Request*>(cqe.user_data);
+
+        if (request != nullptr)
+        {
+            request->result = cqe.res;
+            request->complete = true;
+            m_inFlight--;
+
+            if (request->waiter)
+                m_resumable.push_back(std::exchange(request->waiter, nullptr));
+        }
+    }
+
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+}
+
+bool IOUring::wait(Request& request)
+{
+    reap();
+
+    while (!request.complete)
+    {
+        if (!enter(1)) return false;
+        reap();
+    }
+
+    return true;
+}
+
+IOUring::Completion::Completion(Request& request)
+    : m_request{request}
+{}
+
+bool IOUring::Completion::await_ready() noexcept
+{
+    return m_request.complete;
+}
+
+void IOUring::Completion::await_suspend(std::coroutine_handle<> handle) noexcept
+{
+    m_request.waiter = handle;
+}
+
+void IOUring::Completion::await_resume() noexcept {}
+
+IOUring::Completion IOUring::completion(Request& request)
+{
+    return Completion{request};
+}
+
+bool IOUring::wait()
+{
+    if (!enter(1)) return false;
+
+    reap();
+
+    // Resumed coroutines prepare their next requests, which go out with the
+    // next wait. Indexed, as resuming may add to the list.
+    for (size_t i = 0; i < m_resumable.size(); i++)
+        m_resumable[i].resume();
+
+    m_resumable.clear();
+    return true;
+}
+
+bool IOUring::run()
+{
+    while (m_inFlight > 0)
+    {
+        if (!wait()) return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+#endif
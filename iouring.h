@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef IOURING_H
+#define IOURING_H
+
+#ifdef __linux
+
+#include <coroutine>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper talking to the kernel directly.
+// A single ring can be shared by any number of devices on the same thread,
+// completions are handed back to whichever request submitted them, and
+// coroutines waiting on a request are resumed once it completes.
+class IOUring
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        SETUP_FAILED,
+        MMAP_FAILED,
+        QUEUE_FULL,
+        ENTER_FAILED,
+        NOT_SETUP
+    };
+
+    struct Request
+    {
+        int32_t result = 0;
+        bool complete = true;
+        std::coroutine_handle<> waiter;
+    };
+
+    class Completion
+    {
+    public:
+        Completion(Request& request);
+
+        bool await_ready() noexcept;
+        void await_suspend(std::coroutine_handle<> handle) noexcept;
+        void await_resume() noexcept;
+
+    private:
+        Request& m_request;
+    };
+
+    IOUring(const uint32_t& entries);
+    ~IOUring();
+
+    IOUring(const IOUring&) = delete;
+    IOUring& operator=(const IOUring&) = delete;
+
+    const Error& error();
+    std::string errorStr();
+
+    bool setup();
+
+    // Returns a zeroed SQE whose completion will be stored in request,
+    // or nullptr if the submission queue is full.
+    io_uring_sqe* prepare(Request* request);
+
+    // Submits everything prepared so far without waiting.
+    bool submit();
+
+    // Submits and then reaps completions until request is complete.
+    bool wait(Request& request);
+
+    // Hands out any completions that are already available.
+    void reap();
+
+    // Suspends the calling coroutine until request is complete,
+    // it is resumed from wait()
+    Completion completion(Request& request);
+
+    // Submits everything prepared so far, waits for any request to complete
+    // and resumes the coroutines waiting on the requests that did.
+    bool wait();
+
+    // Calls wait() until no request is in flight anymore
+    bool run();
+
+private:
+    Error m_error;
+    uint32_t m_entries;
+    int32_t m_fd;
+
+    void* m_sqRing;
+    void* m_cqRing;
+    size_t m_sqRingSize;
+    size_t m_cqRingSize;
+    io_uring_sqe* m_sqes;
+    size_t m_sqesSize;
+
+    uint32_t* m_sqHead;
+    uint32_t* m_sqTail;
+    uint32_t* m_sqMask;
+    uint32_t* m_sqArray;
+
+    uint32_t* m_cqHead;
+    uint32_t* m_cqTail;
+    uint32_t* m_cqMask;
+    io_uring_cqe* m_cqes;
+
+    uint32_t m_toSubmit;
+    uint32_t m_inFlight;
+    std::vector<std::coroutine_handle<>> m_resumable;
+
+    bool enter(uint32_t minComplete);
+};
+
+#endif
+
+#endif // IOURING_H
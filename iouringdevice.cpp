@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "iouringdevice.h"
+
+#ifdef __linux
+
+IOUringDevice::IOUringDevice(IOUring& ring,
+                             const std::filesystem::path& devicePath,
+                             const DeviceProperties& deviceProperties,
+                             const int32_t& readTimeout)
+    : SerialDevice{devicePath, deviceProperties, readTimeout},
+      m_ring{ring},
+      m_timeout{readTimeout / 1000, (readTimeout % 1000) * 1000000L}
+{}
+
+void IOUringDevice::prepareWrite(io_uring_sqe* sqe, std::span<const unsigned char> bytes)
+{
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = m_linuxFD;
+    sqe->addr = reinterpret_cast<uint64_t>(bytes.data());
+    sqe->len = bytes.size();
+}
+
+void IOUringDevice::prepareRead(io_uring_sqe* sqe, std::span<unsigned char> bytes)
+{
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_linuxFD;
+    sqe->addr = reinterpret_cast<uint64_t>(bytes.data());
+    sqe->len = bytes.size();
+}
+
+void IOUringDevice::prepareTimeout(io_uring_sqe* sqe)
+{
+    sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(&m_timeout);
+    sqe->len = 1;
+}
+
+bool IOUringDevice::readResult(size_t& bytesRead)
+{
+    // Cancelled by the linked timeout, nothing arrived in time
+    if (m_readRequest.result == -ECANCELED || m_readRequest.result == -EINTR)
+    {
+        m_error = Error::NONE;
+        return true;
+    }
+
+    if (m_readRequest.result < 0)
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    bytesRead = m_readRequest.result;
+    m_error = Error::NONE;
+    return true;
+}
+
+bool IOUringDevice::read(std::span<unsigned char> bytes)
+{
+    size_t bytesRead;
+    return readSome(bytes, bytesRead);
+}
+
+bool IOUringDevice::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    io_uring_sqe* readSQE = m_ring.prepare(&m_readRequest);
+    io_uring_sqe* timeoutSQE = readSQE ? m_ring.prepare(&m_timeoutRequest) : nullptr;
+
+    if (timeoutSQE == nullptr)
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    prepareRead(readSQE, bytes);
+    readSQE->flags |= IOSQE_IO_LINK;
+    prepareTimeout(timeoutSQE);
+
+    if (!m_ring.wait(m_readRequest) || !m_ring.wait(m_timeoutRequest))
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    return readResult(bytesRead);
+}
+
+bool IOUringDevice::write(std::span<const unsigned char> bytes)
+{
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    io_uring_sqe* sqe = m_ring.prepare(&m_writeRequest);
+
+    if (sqe == nullptr)
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    prepareWrite(sqe, bytes);
+
+    if (m_ring.wait(m_writeRequest) &&
+            m_writeRequest.result == static_cast<int32_t>(bytes.size()))
+    {
+        m_error = Error::NONE;
+        return true;
+    }
+    else
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+}
+
+Task<bool> IOUringDevice::readSomeAsync(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        co_return false;
+    }
+
+    io_uring_sqe* readSQE = m_ring.prepare(&m_readRequest);
+    io_uring_sqe* timeoutSQE = readSQE ? m_ring.prepare(&m_timeoutRequest) : nullptr;
+
+    if (timeoutSQE == nullptr)
+    {
+        m_error = Error::READ_FAILED;
+        co_return false;
+    }
+
+    prepareRead(readSQE, bytes);
+    readSQE->flags |= IOSQE_IO_LINK;
+    prepareTimeout(timeoutSQE);
+
+    co_await m_ring.completion(m_readRequest);
+    co_await m_ring.completion(m_timeoutRequest);
+
+    co_return readResult(bytesRead);
+}
+
+Task<bool> IOUringDevice::writeAsync(std::span<const unsigned char> bytes)
+{
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        co_return false;
+    }
+
+    io_uring_sqe* sqe = m_ring.prepare(&m_writeRequest);
+
+    if (sqe == nullptr)
+    {
+        m_error = Error::WRITE_FAILED;
+        co_return false;
+    }
+
+    prepareWrite(sqe, bytes);
+
+    co_await m_ring.completion(m_writeRequest);
+
+    if (m_writeRequest.result != static_cast<int32_t>(bytes.size()))
+    {
+        m_error = Error::WRITE_FAILED;
+        co_return false;
+    }
+
+    m_error = Error::NONE;
+    co_return true;
+}
+
+std::chrono::microseconds IOUringDevice::pendingTransmitTime()
+{
+    return SerialDevice::pendingTransmitTime();
+}
+
+bool IOUringDevice::transact(std::span<const unsigned char> request,
+                             std::span<unsigned char> reply,
+                             size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    io_uring_sqe* writeSQE = m_ring.prepare(&m_writeRequest);
+    io_uring_sqe* readSQE = writeSQE ? m_ring.prepare(&m_readRequest) : nullptr;
+    io_uring_sqe* timeoutSQE = readSQE ? m_ring.prepare(&m_timeoutRequest) : nullptr;
+
+    if (timeoutSQE == nullptr)
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    prepareWrite(writeSQE, request);
+    writeSQE->flags |= IOSQE_IO_LINK;
+    prepareRead(readSQE, reply);
+    readSQE->flags |= IOSQE_IO_LINK;
+    prepareTimeout(timeoutSQE);
+
+    // All three must be reaped before the buffers can be reused
+    if (!m_ring.wait(m_writeRequest) ||
+            !m_ring.wait(m_readRequest) ||
+            !m_ring.wait(m_timeoutRequest))
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    if (m_writeRequest.result != static_cast<int32_t>(request.size()))
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    return readResult(bytesRead);
+}
+
+#endif
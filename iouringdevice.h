@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef IOURINGDEVICE_H
+#define IOURINGDEVICE_H
+
+#ifdef __linux
+
+#include "serialdevice.h"
+#include "asyncdevice.h"
+#include "iouring.h"
+
+// Serial device which performs its I/O through an io_uring.
+// Port setup is identical to SerialDevice, only reads and writes differ.
+// The async functions let many devices share one ring, driven by IOUring::run().
+class IOUringDevice : public SerialDevice, public AsyncDevice
+{
+public:
+
+    IOUringDevice(IOUring& ring,
+                  const std::filesystem::path& devicePath,
+                  const DeviceProperties& deviceProperties,
+                  const int32_t& readTimeout);
+
+    bool read(std::span<unsigned char> bytes);
+    bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    // Queues the write, the read for the reply and a timeout for the read
+    // as linked SQEs, so the whole exchange needs a single io_uring_enter.
+    bool transact(std::span<const unsigned char> request,
+                  std::span<unsigned char> reply,
+                  size_t& bytesRead);
+
+    Task<bool> readSomeAsync(std::span<unsigned char> bytes, size_t& bytesRead);
+    Task<bool> writeAsync(std::span<const unsigned char> bytes);
+
+    std::chrono::microseconds pendingTransmitTime();
+
+private:
+    IOUring& m_ring;
+
+    IOUring::Request m_writeRequest;
+    IOUring::Request m_readRequest;
+    IOUring::Request m_timeoutRequest;
+    __kernel_timespec m_timeout;
+
+    void prepareWrite(io_uring_sqe* sqe, std::span<const unsigned char> bytes);
+    void prepareRead(io_uring_sqe* sqe, std::span<unsigned char> bytes);
+    void prepareTimeout(io_uring_sqe* sqe);
+
+    bool readResult(size_t& bytesRead);
+};
+
+#endif
+
+#endif // IOURINGDEVICE_H
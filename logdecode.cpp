@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "binarylogger.h"
+
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: vegadude_logdecode <binary log file>" << std::endl;
+        return -1;
+    }
+
+    BinaryLogger::Error error;
+
+    if (!BinaryLogger::decode(argv[1], std::cout, error))
+    {
+        std::cerr << "Failed to decode " << argv[1] << ": "
+                  << (error == BinaryLogger::Error::INVALID_FORMAT ? "not a vegadude binary log"
+                      : error == BinaryLogger::Error::OPEN_FAILED ? "could not open file"
+                                                                  : "could not read file")
+                  << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
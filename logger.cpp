@@ -1,20 +1,152 @@
+#ifdef VEGADUDE_MINIMAL
+#include <algorithm>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+#else
 #include <iostream>
+#endif
 
 #include "logger.h"
 
 #include <string>
 #include <string_view>
 
+#ifdef VEGADUDE_MINIMAL
+
+Logger::Logger()
+    : m_log{false},
+      m_fd{-1},
+      m_size{0}
+{}
+
+#else
+
 Logger::Logger()
     : m_log{false}
 {}
 
+#endif
+
 Logger &Logger::get()
 {
     static Logger instance;
     return instance;
 }
 
+#ifdef VEGADUDE_MINIMAL
+
+bool Logger::setup(std::filesystem::path& filePath)
+{
+    m_fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    m_log = m_fd != -1;
+    return m_log;
+}
+
+void Logger::append(std::string_view text)
+{
+    while (!text.empty())
+    {
+        size_t count = std::min(text.size(), m_buffer.size() - m_size);
+        std::copy_n(text.begin(), count, m_buffer.begin() + m_size);
+
+        m_size += count;
+        text.remove_prefix(count);
+
+        if (m_size == m_buffer.size()) flush();
+    }
+}
+
+void Logger::flush()
+{
+    if (m_size == 0) return;
+
+    [[maybe_unused]] ssize_t written = ::write(STDERR_FILENO, m_buffer.data(), m_size);
+    if (m_log) written = ::write(m_fd, m_buffer.data(), m_size);
+
+    m_size = 0;
+}
+
+void Logger::showProgress(std::string_view message, const float &ratio)
+{
+    constexpr int32_t barSize = 50;
+    int32_t completeSize = ratio * barSize;
+
+    std::array<char, barSize> bar;
+    std::fill_n(bar.begin(), completeSize, '#');
+    std::fill(bar.begin() + completeSize, bar.end(), '-');
+
+    std::array<char, 4> percent;
+    auto result = std::to_chars(percent.begin(), percent.end(), static_cast<int>(ratio * 100));
+
+    // Goes to stderr only, like the default build
+    bool log = m_log;
+    m_log = false;
+
+    flush();
+    append("\rProgress [");
+    append({bar.data(), bar.size()});
+    append("] - ");
+    append({percent.data(), size_t(result.ptr - percent.data())});
+    append("% - ");
+    append(message);
+    flush();
+
+    m_log = log;
+}
+
+void Logger::close()
+{
+    get() << NewLine;
+
+    if (m_log)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        m_log = false;
+    }
+}
+
+template<typename T>
+Logger& operator<<(Logger& logger, T text)
+{
+    if constexpr (std::is_same_v<T, char>)
+    {
+        logger.append({&text, 1});
+        if (text == Logger::NewLine) logger.flush();
+    }
+    else if constexpr (std::is_same_v<T, bool> || std::is_integral_v<T> || std::is_floating_point_v<T>)
+    {
+        std::array<char, 32> number;
+        std::to_chars_result result;
+
+        // Same as the default precision of iostreams
+        if constexpr (std::is_floating_point_v<T>)
+            result = std::to_chars(number.begin(), number.end(), text, std::chars_format::general, 6);
+        else if constexpr (std::is_same_v<T, bool>)
+            result = std::to_chars(number.begin(), number.end(), static_cast<int>(text));
+        else
+            result = std::to_chars(number.begin(), number.end(), text);
+
+        logger.append({number.data(), size_t(result.ptr - number.data())});
+    }
+    else if constexpr (std::is_same_v<T, std::filesystem::path>)
+    {
+        logger.append("\"");
+        logger.append(text.native());
+        logger.append("\"");
+    }
+    else
+    {
+        logger.append(std::string_view{text});
+    }
+
+    return logger;
+}
+
+#else
+
 bool Logger::setup(std::filesystem::path& filePath)
 {
     m_stream.open(filePath, std::ofstream::out | std::ofstream::trunc);
@@ -23,7 +155,7 @@ bool Logger::setup(std::filesystem::path& filePath)
     return m_log;
 }
 
-void Logger::showProgress(const std::string& message, const float &ratio)
+void Logger::showProgress(std::string_view message, const float &ratio)
 {
     constexpr int32_t barSize = 50;
     int32_t completeSize = ratio * barSize;
@@ -56,6 +188,8 @@ Logger& operator<<(Logger& logger, T text)
     return logger;
 }
 
+#endif
+
 template Logger& operator<<(Logger&, size_t);
 template Logger& operator<<(Logger&, int32_t);
 template Logger& operator<<(Logger&, bool);
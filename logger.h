@@ -2,9 +2,15 @@
 #define LOGGER_H
 
 #include <memory>
+#include <filesystem>
+#include <string_view>
+
+#ifdef VEGADUDE_MINIMAL
+#include <array>
+#else
 #include <ostream>
 #include <fstream>
-#include <filesystem>
+#endif
 
 class Logger
 {
@@ -14,7 +20,7 @@ public:
     static Logger& get();
     bool setup(std::filesystem::path& filePath);
 
-    void showProgress(const std::string& message, const float& ratio);
+    void showProgress(std::string_view message, const float& ratio);
 
     void close();
 
@@ -25,7 +31,21 @@ public:
 
 private:
     bool m_log;
+
+#ifdef VEGADUDE_MINIMAL
+    // Text is formatted into m_buffer and written to stderr, and the log
+    // file, with plain write calls once a line ends or the buffer fills up
+    constexpr static size_t BufferSize {256};
+
+    int m_fd;
+    std::array<char, BufferSize> m_buffer;
+    size_t m_size;
+
+    void append(std::string_view text);
+    void flush();
+#else
     std::ofstream m_stream;
+#endif
 };
 
 
@@ -12,16 +12,45 @@
  */
 
 #include "logger.h"
+#include "binarylogger.h"
 #include "serialdevice.h"
+#include "networkdevice.h"
+#include "capturedevice.h"
+#include "replaydevice.h"
+#include "buffereddevice.h"
+#include "iouringdevice.h"
+#include "asyncserialdevice.h"
+#include "asyncxmodem.h"
+#include "packetfile.h"
+#include "realtime.h"
+#include "portbroker.h"
+#include "sharedstatus.h"
+#include "filewatcher.h"
+#include "portindex.h"
+#include "soak.h"
+#include "archive.h"
+#include "xmodemsender.h"
+
+#include <algorithm>
+#include <charconv>
+#include <csignal>
+#include <memory>
 #include "xmodem.h"
 
+constexpr int32_t RESET_HANDSHAKE_TIMEOUT {2000};
+
 enum ArgType
 {
     LOG_TO_FILE,
+    BINARY_LOG,
+    CAPTURE,
     BINARY_PATH,
+    OUTPUT_PATH,
     TARGET_PATH,
     XMODEM_MAX_RETRY,
     XMODEM_BLOCK_SIZE,
+    XMODEM_HANDSHAKE_TIMEOUT,
+    RESET_SEQUENCE,
     SERIAL_DEVICE_ARIES,
     SERIAL_PARITY_YES,
     SERIAL_STOP_BITS,
@@ -29,7 +58,18 @@ enum ArgType
     SERIAL_BITS,
     SERIAL_BAUD_RATE,
     SERIAL_READ_TIMEOUT,
+    SERIAL_IO_URING,
+    SERIAL_DRAIN,
     START_AFTER_UPLOAD,
+    REALTIME,
+    ACK_LATENCY_STATS,
+    SHARED_STATUS,
+    WATCH,
+    SOAK,
+    PATCH,
+    STRIP_PADDING,
+    BROKER_CONSOLES,
+    PRINT_PORTS,
     PRINT_LICENSE,
     PRINT_USAGE,
     INVALID
@@ -42,9 +82,18 @@ ArgType getArgType(char* const& arg)
     if(!string(arg).compare("-l") ||
             !string(arg).compare("--log"))
         return ArgType::LOG_TO_FILE;
+    else if (!string(arg).compare("-bl") ||
+            !string(arg).compare("--binary-log"))
+        return ArgType::BINARY_LOG;
+    else if (!string(arg).compare("-cap") ||
+            !string(arg).compare("--capture"))
+        return ArgType::CAPTURE;
     else if (!string(arg).compare("-bp") ||
             !string(arg).compare("--binary-path"))
         return ArgType::BINARY_PATH;
+    else if (!string(arg).compare("-o") ||
+            !string(arg).compare("--output"))
+        return ArgType::OUTPUT_PATH;
     else if (!string(arg).compare("-tp") ||
             !string(arg).compare("--target-path"))
         return ArgType::TARGET_PATH;
@@ -54,6 +103,12 @@ ArgType getArgType(char* const& arg)
     else if(!string(arg).compare("-xbs") ||
             !string(arg).compare("--xmodem-block-size"))
         return ArgType::XMODEM_BLOCK_SIZE;
+    else if(!string(arg).compare("-xht") ||
+            !string(arg).compare("--xmodem-handshake-timeout"))
+        return ArgType::XMODEM_HANDSHAKE_TIMEOUT;
+    else if(!string(arg).compare("-rs") ||
+            !string(arg).compare("--reset-sequence"))
+        return ArgType::RESET_SEQUENCE;
     else if(!string(arg).compare("--aries"))
         return ArgType::SERIAL_DEVICE_ARIES;
     else if(!string(arg).compare("-sp") ||
@@ -71,12 +126,45 @@ ArgType getArgType(char* const& arg)
     else if(!string(arg).compare("-sbr") ||
             !string(arg).compare("--serial-baud-rate"))
         return ArgType::SERIAL_BAUD_RATE;
+    else if(!string(arg).compare("-sd") ||
+            !string(arg).compare("--serial-drain"))
+        return ArgType::SERIAL_DRAIN;
     else if(!string(arg).compare("-sau") ||
             !string(arg).compare("--start-after-upload"))
         return ArgType::START_AFTER_UPLOAD;
+    else if(!string(arg).compare("-rt") ||
+            !string(arg).compare("--realtime"))
+        return ArgType::REALTIME;
+    else if(!string(arg).compare("-als") ||
+            !string(arg).compare("--ack-latency-stats"))
+        return ArgType::ACK_LATENCY_STATS;
+    else if(!string(arg).compare("-ss") ||
+            !string(arg).compare("--shared-status"))
+        return ArgType::SHARED_STATUS;
+    else if(!string(arg).compare("-w") ||
+            !string(arg).compare("--watch"))
+        return ArgType::WATCH;
+    else if(!string(arg).compare("-sk") ||
+            !string(arg).compare("--soak"))
+        return ArgType::SOAK;
+    else if(!string(arg).compare("-pt") ||
+            !string(arg).compare("--patch"))
+        return ArgType::PATCH;
+    else if(!string(arg).compare("-stp") ||
+            !string(arg).compare("--strip-padding"))
+        return ArgType::STRIP_PADDING;
+    else if(!string(arg).compare("-bc") ||
+            !string(arg).compare("--broker-consoles"))
+        return ArgType::BROKER_CONSOLES;
     else if(!string(arg).compare("-srt") ||
             !string(arg).compare("--serial-read-timeout"))
         return ArgType::SERIAL_READ_TIMEOUT;
+    else if(!string(arg).compare("-siu") ||
+            !string(arg).compare("--serial-io-uring"))
+        return ArgType::SERIAL_IO_URING;
+    else if(!string(arg).compare("-ls") ||
+            !string(arg).compare("--list"))
+        return ArgType::PRINT_PORTS;
     else if(!string(arg).compare("--license"))
         return ArgType::PRINT_LICENSE;
     else if(!string(arg).compare("-h") ||
@@ -100,21 +188,59 @@ To view the full license, you may visit:
 
 void printUsage()
 {
-    constexpr const std::string_view usage = R"(Usage:  [-l | --log] [-bp | --binary-path]
-        [-tp | --target-path]
+    constexpr const std::string_view usage = R"(Usage:  [-l | --log] [-bl | --binary-log] [-cap | --capture]
+        [-bp | --binary-path] [-tp | --target-path]
         [-xmr | --xmodem-max-retry] [-xbs | --xmodem-block-size]
+        [-xht | --xmodem-handshake-timeout] [-rs | --reset-sequence]
         [--aries] [-sp | --serial-parity] [-ssb | --serial-stop-bits]
         [-src | --serial-rts-cts] [-sb | --serial-bits]
         [-sbr | --serial-baud-rate] [-srt | --serial-read-timeout]
-        [-sau | --start-after-upload] [--license] [-h | --help]
+        [-siu | --serial-io-uring] [-sd | --serial-drain]
+        [-sau | --start-after-upload] [-rt | --realtime]
+        [-als | --ack-latency-stats] [-ss | --shared-status]
+        [-w | --watch] [-sk | --soak] [-pt | --patch]
+        [-ls | --list] [--license] [-h | --help]
+
+        pack [-bp | --binary-path] [-o | --output]
+        [--aries] [-xbs | --xmodem-block-size]
+
+        download [-tp | --target-path] [-o | --output]
+        [-stp | --strip-padding] [--aries] ...
+
+        broker [-tp | --target-path] [-bc | --broker-consoles]
+        [--aries] ...
+
+        status [-tp | --target-path]
 
 Option Summary:
     -l | --log                          Optional. Create a log file.
 
+    -bl | --binary-log                  Optional. Record every protocol event of the
+                                        transfer into a compact binary log, written
+                                        from a background thread. Decode it with
+                                        vegadude_logdecode.
+
+    -cap | --capture                    Optional. Record every byte sent to and
+                                        received from the target, with the time it
+                                        was seen, into a capture file. Pass
+                                        replay://<capture file> as target path to
+                                        play the target's side of it back.
+
     -bp | --binary-path                 Required. Specify path to the binary file
-                                        to be uploaded.
+                                        to be uploaded. A file inside a tar or cpio
+                                        archive is uploaded straight from the
+                                        archive when given as archive:member,
+                                        e.g. bundle.tar:images/board.bin
 
     -tp | --target-path                 Required. Specify path to the target board.
+                                        Can be repeated to upload to several boards
+                                        at once (Linux only).
+                                        tcp://host:port and rfc2217://host:port
+                                        reach a board behind a serial server.
+                                        sn://serial and usb://port path select
+                                        a USB board, see --list (Linux only).
+                                        replay://path replays a capture made with
+                                        --capture.
 
     -xmr | --xmodem-max-retry           Optional. Specify max amount of times to retry before aborting upload.
                                         Default is 10.
@@ -122,6 +248,17 @@ Option Summary:
     -xbs | --xmodem-block-size          Required if not using automatic configuration.
                                         Specify block size of XModem data transfer.
 
+    -xht | --xmodem-handshake-timeout   Optional. Specify how long to wait for the
+                                        target to request the upload, in milliseconds.
+                                        0 waits forever. Default is 60000, or 2000
+                                        when a reset sequence is used.
+
+    -rs | --reset-sequence              Optional. Toggle DTR/RTS after opening the
+                                        target to reset it into its bootloader.
+                                        Steps are line=level:milliseconds separated
+                                        by commas, run in order. Example:
+                                        dtr=0:10,rts=1:100,rts=0:50
+
     --aries                             Use CDAC Aries serial port configuration.
 
     -sp | --serial-parity               Optional. Specify if target uses parity bit.
@@ -144,18 +281,100 @@ Option Summary:
                                         milliseconds.
                                         Default is 500.
 
+    -siu | --serial-io-uring            Optional. Perform serial I/O through io_uring
+                                        (Linux only). All targets share one ring.
+                                        Falls back to regular reads and writes if
+                                        io_uring is unavailable.
+
+    -sd | --serial-drain                Optional. Wait for every packet to leave the
+                                        serial port before starting its ACK timeout
+                                        and reporting it as sent. Without it the
+                                        timeout still starts only after the bytes
+                                        queued in the port would have been sent.
+                                        Single target only.
+
     -sau | --start-after-upload         Optional. Immediately start running program
                                         after uploading.
 
+    -rt | --realtime                    Optional. Run the transfer at SCHED_FIFO
+                                        priority, given as priority[:cpu]. With a
+                                        cpu the thread is also pinned to it. Memory
+                                        is locked with mlockall and the image is
+                                        paged in before the handshake. Steps the
+                                        process lacks privileges for are skipped
+                                        with a warning. Example: 50:2
+
+    -als | --ack-latency-stats          Optional. Print the distribution of time
+                                        between receiving an ACK and starting to
+                                        send the next packet (single target only).
+
+    -ss | --shared-status               Optional. Publish the state of each upload in
+                                        a shared memory segment named after its
+                                        target, such as /vegadude-dev_ttyUSB0.
+                                        Read it with the status command.
+
+    -w | --watch                        Optional. Keep the target open after the
+                                        upload and upload again every time the
+                                        binary changes, until interrupted. The
+                                        target is reset with --reset-sequence
+                                        first. Rewrites that leave the binary as
+                                        it was are skipped (Linux only).
+
+    -sk | --soak                        Optional. Upload this many times in a row,
+                                        resetting the target with --reset-sequence
+                                        before each, then print the throughput,
+                                        handshake time, retries and resident set
+                                        size of every upload with their mean,
+                                        variance and trend. Fails if throughput
+                                        fell or memory grew over the uploads.
+
+    -pt | --patch                       Optional. Overlay bytes on the image while it
+                                        is sent, given as offset=file or offset=hex,
+                                        e.g. 0x400=00a1b2c3 or 4096=calibration.bin.
+                                        The value is read from the file if one
+                                        exists, otherwise taken as hex. Can be given
+                                        more than once. Only patched blocks are
+                                        framed again for every upload, the others
+                                        are framed once per run, or never with a
+                                        packed image.
+
+    -o | --output                       pack: Optional. Specify path of the packet
+                                        file to create. Default is the binary path
+                                        with its extension replaced by .vdpkt.
+                                        download: Required. Specify path of the file
+                                        to receive into.
+
+    -stp | --strip-padding              Optional, download only. Remove the SUB (0x1a)
+                                        padding at the end of the received file.
+
+    -bc | --broker-consoles             Optional, broker only. Number of console
+                                        terminals to create. Default is 1.
+
+    -ls | --list                        List the serial ports of this machine, with
+                                        the USB IDs, port path, serial number and
+                                        driver of each.
+
     --license                           Print license information.
 
     -h | --help                         Print this message.
 
-NOTE: you cannot use --aries and --xmodem-block-size / --serial* arguments (except --serial-read-timeout) at the same time.)";
+NOTE: you cannot use --aries and --xmodem-block-size / --serial* arguments (except --serial-read-timeout) at the same time.
+
+pack frames the binary into XMODEM packets with their CRC ahead of time and writes
+them into a .vdpkt file. Passing that file as --binary-path uploads it as is.
+
+download receives a file sent by the target over XMODEM, such as a memory dump.
+It accepts the same target and serial options as an upload.
+
+broker keeps the target open and shares it through pseudo terminals (Linux only).
+Consoles attach to the console terminals, uploads use the upload terminal as
+target path, and hold the port for themselves until they finish.
+
+status prints the last state published with --shared-status for each target.)";
     Logger::get() << usage << Logger::NewLine;
 }
 
-bool validateProps(const std::filesystem::path& targetPath,
+bool validateProps(const std::vector<std::filesystem::path>& targetPaths,
                    const int32_t& xmodemMaxRetry,
                    const int32_t& xmodemBlockSize,
                    const int32_t& serialReadTimeout,
@@ -163,7 +382,7 @@ bool validateProps(const std::filesystem::path& targetPath,
 {
     bool valid = true;
 
-    if (targetPath.empty())
+    if (targetPaths.empty())
     {
         Logger::get() << "Target path not specified." << Logger::NewLine;
         valid = false;
@@ -242,18 +461,755 @@ int stoi_e(char* str)
 {
     int result = -1;
 
-    try
+    std::string_view text{str};
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+
+    if (error != std::errc{} || end != text.data() + text.size())
+        result = -1;
+
+    return result;
+}
+
+int uploadConcurrently(const std::vector<std::filesystem::path>& targetPaths,
+                       const std::filesystem::path& binaryPath,
+                       const SerialDevice::DeviceProperties& dp,
+                       const int32_t& serialReadTimeout,
+                       const int32_t& xmodemMaxRetry,
+                       const int32_t& xmodemBlockSize,
+                       const XModem::Timeouts& xmodemTimeouts,
+                       const SerialDevice::ResetSequence& resetSequence,
+                       const bool& startAfterUpload,
+                       const bool& sharedStatus,
+                       const XModem::Patches& patches,
+                       bool useIOUring)
+{
+#ifdef __linux
+    // Every port goes through one ring, so a single io_uring_enter submits
+    // the packets of all targets and reaps whatever has completed
+    IOUring ring{static_cast<uint32_t>(targetPaths.size() * 4)};
+
+    if (useIOUring && !ring.setup())
+    {
+        Logger::get() << ring.errorStr() << ", falling back to epoll." << Logger::NewLine;
+        useIOUring = false;
+    }
+
+    EventLoop loop;
+
+    if (!useIOUring && !loop.setup())
     {
-        result = std::stoi(str);
+        Logger::get() << loop.errorStr() << Logger::NewLine;
+        return -1;
     }
-    catch(const std::invalid_argument&)
+
+    std::vector<std::unique_ptr<SerialDevice>> devices;
+    std::vector<std::unique_ptr<AsyncXModem>> modems;
+    std::vector<std::unique_ptr<SharedStatus>> statuses;
+    std::vector<Task<bool>> uploads;
+
+    for (auto& targetPath : targetPaths)
     {
-        result = -1;
+        if (NetworkDevice::isNetworkPath(targetPath.string()))
+        {
+            Logger::get() << "Network targets cannot be uploaded to concurrently." << Logger::NewLine;
+            return -1;
+        }
+
+        AsyncDevice* asyncDevice;
+        bool opened;
+
+        // open() is not virtual, AsyncSerialDevice also switches to non-blocking I/O
+        if (useIOUring)
+        {
+            auto device = std::make_unique<IOUringDevice>(ring, targetPath, dp, serialReadTimeout);
+            device->setResetSequence(resetSequence);
+            opened = device->open();
+            asyncDevice = device.get();
+            devices.push_back(std::move(device));
+        }
+        else
+        {
+            auto device = std::make_unique<AsyncSerialDevice>(loop, targetPath, dp, serialReadTimeout);
+            device->setResetSequence(resetSequence);
+            opened = device->open();
+            asyncDevice = device.get();
+            devices.push_back(std::move(device));
+        }
+
+        auto& device = devices.back();
+
+        if (!opened)
+        {
+            Logger::get() << "Failed to setup serial device " << targetPath << "!"
+                          << Logger::NewLine << device->errorStr()
+                          << Logger::NewLine;
+            return -1;
+        }
+
+        auto& modem = modems.emplace_back(std::make_unique<AsyncXModem>(*asyncDevice, xmodemMaxRetry, xmodemBlockSize));
+        modem->setTimeouts(xmodemTimeouts);
+        modem->setPatches(patches);
+
+        if (sharedStatus)
+        {
+            auto& status = statuses.emplace_back(std::make_unique<SharedStatus>());
+
+            if (status->open(targetPath.string()))
+                modem->setSharedStatus(status.get());
+            else
+                Logger::get() << targetPath << ": Unable to publish shared status! "
+                              << status->errorStr() << Logger::NewLine;
+        }
+
+        uploads.push_back(modem->upload(binaryPath, startAfterUpload, false));
+    }
+
+    Logger::get() << "Uploading to " << targetPaths.size() << " targets..." << Logger::NewLine;
+
+    if (useIOUring)
+    {
+        for (auto& upload : uploads)
+            upload.start();
+
+        if (!ring.run())
+        {
+            Logger::get() << ring.errorStr() << Logger::NewLine;
+            return -1;
+        }
+    }
+    else
+    {
+        for (auto& upload : uploads)
+            loop.spawn(upload);
+
+        if (!loop.run())
+        {
+            Logger::get() << loop.errorStr() << Logger::NewLine;
+            return -1;
+        }
+    }
+
+    int result = 0;
+
+    for (size_t i = 0; i < targetPaths.size(); i++)
+    {
+        if (uploads[i].done() && uploads[i].result())
+        {
+            Logger::get() << targetPaths[i] << ": Successfully uploaded program!" << Logger::NewLine;
+        }
+        else
+        {
+            Logger::get() << targetPaths[i] << ": Failed to upload file! "
+                          << ((modems[i]->error() == XModem::Error::DEVICE_RELATED) ? devices[i]->errorStr() : modems[i]->errorStr())
+                          << Logger::NewLine;
+            result = -1;
+        }
+    }
+
+    Logger::get().close();
+
+    return result;
+#else
+    Logger::get() << "Uploading to multiple targets at once is only supported on Linux."
+                  << Logger::NewLine;
+    return -1;
+#endif
+}
+
+// What to do once the target is connected
+struct Transfer
+{
+    bool download = false;
+    std::filesystem::path binaryPath;
+    std::filesystem::path outputPath;
+    bool startAfterUpload = false;
+    bool stripPadding = false;
+    std::filesystem::path capturePath;
+    bool prefault = false;
+    bool ackLatencyStats = false;
+    bool drain = false;
+    // Target the shared status is named after, empty if not published
+    std::string sharedStatus;
+    bool watch = false;
+    // Number of uploads in a row, 0 for a single one without statistics
+    int32_t soak = 0;
+    XModem::Patches patches;
+};
+
+// The capture sits right on top of the device, so it sees the raw wire
+bool startCapture(CaptureDevice& capture, const std::filesystem::path& capturePath)
+{
+    if (capturePath.empty()) return true;
+
+    if (!capture.open(capturePath))
+    {
+        Logger::get() << "Unable to start capture! " << capture.errorStr() << Logger::NewLine;
+        return false;
+    }
+
+    return true;
+}
+
+// Raises the calling thread, which also runs the transfer, as far as the
+// process is allowed to
+void applyRealTime(const RealTime::Options& options)
+{
+    RealTime realTime;
+
+    if (!realTime.lockMemory())
+        Logger::get() << "Warning: memory not locked, " << realTime.errorStr() << Logger::NewLine;
+
+    if (!realTime.setPriority(options.priority))
+        Logger::get() << "Warning: real-time priority not set, " << realTime.errorStr() << Logger::NewLine;
+
+    if (options.cpu != -1 && !realTime.pinToCPU(options.cpu))
+        Logger::get() << "Warning: not pinned to CPU " << options.cpu << ", "
+                      << realTime.errorStr() << Logger::NewLine;
+}
+
+void printAckLatencies(std::vector<std::chrono::nanoseconds> latencies)
+{
+    if (latencies.empty())
+    {
+        Logger::get() << "No ACK to next write latencies recorded." << Logger::NewLine;
+        return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    auto microseconds = [&](const double& percentile) {
+        size_t index = std::min(latencies.size() - 1, size_t(percentile * latencies.size()));
+        return std::chrono::duration<double, std::micro>(latencies[index]).count();
+    };
+
+    Logger::get() << "ACK to next write latency over " << latencies.size() << " blocks (in microseconds):" << Logger::NewLine
+                  << "min " << microseconds(0)
+                  << ", p50 " << microseconds(0.5)
+                  << ", p90 " << microseconds(0.9)
+                  << ", p99 " << microseconds(0.99)
+                  << ", p99.9 " << microseconds(0.999)
+                  << ", max " << microseconds(1) << Logger::NewLine;
+}
+
+template<typename D>
+bool report(XModem& modem, D& device, const Transfer& options, const bool& success)
+{
+    if (!success)
+    {
+        Logger::get() << (options.download ? "Failed to download file!" : "Failed to upload file!")
+                      << Logger::NewLine
+                      << ((modem.error() == XModem::Error::DEVICE_RELATED) ? device.errorStr() : modem.errorStr())
+                      << Logger::NewLine;
+        return false;
+    }
+
+    if (options.ackLatencyStats && !options.download)
+        printAckLatencies(modem.ackLatencies());
+
+    if (options.download)
+        Logger::get() << "Successfully downloaded into " << options.outputPath;
+    else
+        Logger::get() << (options.startAfterUpload ?
+                              "Successfully uploaded and started program!"
+                            : "Successfully uploaded program! Press enter in serial terminal to start program.");
+
+    return true;
+}
+
+FileWatcher* activeWatcher = nullptr;
+XModem* activeModem = nullptr;
+
+void stopWatching(int)
+{
+    if (activeWatcher) activeWatcher->stop();
+    if (activeModem) activeModem->cancel();
+}
+
+// Uploads the binary again every time it changes, until interrupted. The
+// target stays open in between and is reset before every upload.
+template<typename D>
+bool watch(XModem& modem, D& device, const Transfer& options, bool success)
+{
+    FileWatcher watcher;
+
+    // Members of an archive change with the archive
+    std::filesystem::path watchedPath = options.binaryPath;
+    std::string memberPath;
+    Archive::splitMemberPath(options.binaryPath.string(), watchedPath, memberPath);
+
+    if (!watcher.setup(watchedPath))
+    {
+        Logger::get() << Logger::NewLine << "Unable to watch " << watchedPath << "! "
+                      << watcher.errorStr() << Logger::NewLine;
+        return false;
+    }
+
+    activeWatcher = &watcher;
+    activeModem = &modem;
+    std::signal(SIGINT, stopWatching);
+    std::signal(SIGTERM, stopWatching);
+
+    Logger::get() << Logger::NewLine << "Watching " << watchedPath
+                  << " for changes, press Ctrl+C to stop." << Logger::NewLine;
+
+    while (watcher.wait())
+    {
+        Logger::get() << watchedPath << " changed, uploading again." << Logger::NewLine;
+
+        if (!device.reset())
+        {
+            Logger::get() << "Failed to reset target! " << device.errorStr() << Logger::NewLine;
+            success = false;
+            continue;
+        }
+
+        success = report(modem, device, options,
+                         modem.upload(options.binaryPath, options.startAfterUpload));
+
+        if (success)
+            Logger::get() << Logger::NewLine << "Done "
+                          << size_t(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        std::chrono::steady_clock::now() - watcher.lastChange()).count())
+                          << " ms after the last write to the binary." << Logger::NewLine;
+    }
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    activeWatcher = nullptr;
+    activeModem = nullptr;
+
+    if (watcher.error() != FileWatcher::Error::NONE)
+    {
+        Logger::get() << "Stopped watching! " << watcher.errorStr() << Logger::NewLine;
+        return false;
+    }
+
+    return success;
+}
+
+volatile std::sig_atomic_t soakInterrupted = 0;
+
+void stopSoak(int)
+{
+    soakInterrupted = 1;
+    if (activeModem) activeModem->cancel();
+}
+
+// Uploads the binary until options.soak uploads have been made, the first
+// one included, resetting the target before each. Reports how the runs
+// compare and fails if throughput fell or memory grew along the way.
+template<typename D>
+bool soak(XModem& modem, D& device, const Transfer& options)
+{
+    Soak soak;
+    bool success = true;
+
+    auto record = [&]() {
+        const XModem::Summary& summary = modem.lastUpload();
+        double seconds = std::chrono::duration<double>(summary.transferTime).count();
+
+        soak.add({seconds > 0 ? summary.bytes / seconds : 0,
+                  std::chrono::duration<double, std::milli>(summary.handshakeTime).count(),
+                  summary.retries, Soak::residentSetSize()});
+    };
+
+    record();
+
+    activeModem = &modem;
+    std::signal(SIGINT, stopSoak);
+    std::signal(SIGTERM, stopSoak);
+
+    for (int32_t run = 2; run <= options.soak && !soakInterrupted; run++)
+    {
+        Logger::get() << Logger::NewLine << Logger::NewLine
+                      << "Soak upload " << run << " of " << options.soak << Logger::NewLine;
+
+        if (!device.reset())
+        {
+            Logger::get() << "Failed to reset target! " << device.errorStr() << Logger::NewLine;
+            success = false;
+            break;
+        }
+
+        bool uploaded = modem.upload(options.binaryPath, options.startAfterUpload);
+
+        // Interrupted uploads say nothing about the target
+        if (soakInterrupted) break;
+
+        if (!report(modem, device, options, uploaded))
+        {
+            success = false;
+            break;
+        }
+
+        record();
+    }
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    activeModem = nullptr;
+
+    Logger::get() << Logger::NewLine << Logger::NewLine;
+
+    if (soakInterrupted)
+        Logger::get() << "Soak interrupted after " << soak.runs().size() << " uploads." << Logger::NewLine;
+
+    return soak.report() && success;
+}
+
+template<typename D>
+int transfer(XModem& modem, D& device, CaptureDevice& capture, const Transfer& options)
+{
+    modem.setPrefault(options.prefault);
+    modem.setDrain(options.drain);
+    modem.setPatches(options.patches);
+
+    SharedStatus status;
+
+    if (!options.sharedStatus.empty() && !options.download)
+    {
+        if (status.open(options.sharedStatus))
+            modem.setSharedStatus(&status);
+        else
+            Logger::get() << "Unable to publish shared status! " << status.errorStr() << Logger::NewLine;
+    }
+
+    bool success = options.download ?
+                modem.download(options.outputPath, options.stripPadding)
+              : modem.upload(options.binaryPath, options.startAfterUpload);
+
+    if (!capture.close())
+    {
+        Logger::get() << "Failed to save capture! " << capture.errorStr() << Logger::NewLine;
+        success = false;
+    }
+    else if (!options.capturePath.empty())
+    {
+        Logger::get() << "Capture saved to " << options.capturePath << Logger::NewLine;
+    }
+
+    success = report(modem, device, options, success);
+
+    // A replay cannot be reset, it only plays the recorded transfer once
+    if constexpr (!std::is_same_v<D, ReplayDevice>)
+    {
+        if (options.watch) success = watch(modem, device, options, success);
+        if (options.soak > 0 && success) success = soak(modem, device, options);
+    }
+
+    modem.setSharedStatus(nullptr);
+
+    if (!success) return -1;
+
+    Logger::get().close();
+
+    return 0;
+}
+
+int transferOverNetwork(const std::string& address,
+                        const Transfer& options,
+                        const SerialDevice::DeviceProperties& dp,
+                        const int32_t& serialReadTimeout,
+                        const int32_t& xmodemMaxRetry,
+                        const int32_t& xmodemBlockSize,
+                        const XModem::Timeouts& xmodemTimeouts,
+                        const SerialDevice::ResetSequence& resetSequence)
+{
+    NetworkDevice device{address, dp, serialReadTimeout};
+    device.setResetSequence(resetSequence);
+
+    if (!device.open())
+    {
+        Logger::get() << "Failed to setup network device!"
+                      << Logger::NewLine << device.errorStr()
+                      << Logger::NewLine;
+        return -1;
+    }
+
+    CaptureDevice capture{device};
+    if (!startCapture(capture, options.capturePath)) return -1;
+
+    XModem modem{options.capturePath.empty() ? static_cast<Device&>(device) : capture,
+                 xmodemMaxRetry, xmodemBlockSize};
+    modem.setTimeouts(xmodemTimeouts);
+
+    int result = transfer(modem, device, capture, options);
+
+    device.close();
+
+    return result;
+}
+
+int transferFromReplay(const std::string& capturePath,
+                       const Transfer& options,
+                       const int32_t& serialReadTimeout,
+                       const int32_t& xmodemMaxRetry,
+                       const int32_t& xmodemBlockSize,
+                       const XModem::Timeouts& xmodemTimeouts)
+{
+    ReplayDevice device{capturePath, serialReadTimeout};
+
+    if (!device.open())
+    {
+        Logger::get() << "Failed to setup replay device!"
+                      << Logger::NewLine << device.errorStr()
+                      << Logger::NewLine;
+        return -1;
     }
 
+    CaptureDevice capture{device};
+    if (!startCapture(capture, options.capturePath)) return -1;
+
+    XModem modem{options.capturePath.empty() ? static_cast<Device&>(device) : capture,
+                 xmodemMaxRetry, xmodemBlockSize};
+    modem.setTimeouts(xmodemTimeouts);
+
+    int result = transfer(modem, device, capture, options);
+
+    if (device.divergences() > 0)
+        Logger::get() << "Replay diverged from the capture " << device.divergences()
+                      << " times, the host did not send what was recorded." << Logger::NewLine;
+
+    device.close();
+
     return result;
 }
 
+PortBroker* activeBroker = nullptr;
+
+void stopBroker(int)
+{
+    if (activeBroker) activeBroker->stop();
+}
+
+int broker(const std::vector<std::filesystem::path>& targetPaths,
+           const SerialDevice::DeviceProperties& dp,
+           const int32_t& serialReadTimeout,
+           const SerialDevice::ResetSequence& resetSequence,
+           const int32_t& noOfConsoles)
+{
+    if (targetPaths.size() > 1)
+    {
+        Logger::get() << "A broker serves one target." << Logger::NewLine;
+        return -1;
+    }
+
+    if (noOfConsoles < 0)
+    {
+        Logger::get() << "Number of broker consoles invalid." << Logger::NewLine;
+        return -1;
+    }
+
+    SerialDevice device{targetPaths.front(), dp, serialReadTimeout};
+    device.setResetSequence(resetSequence);
+
+    if (!device.open())
+    {
+        Logger::get() << "Failed to setup serial device!"
+                      << Logger::NewLine << device.errorStr()
+                      << Logger::NewLine;
+        return -1;
+    }
+
+    PortBroker portBroker{device};
+
+    if (!portBroker.setup(noOfConsoles))
+    {
+        Logger::get() << "Failed to setup broker! " << portBroker.errorStr() << Logger::NewLine;
+        return -1;
+    }
+
+    for (auto& path : portBroker.consolePaths())
+        Logger::get() << "Console: " << path << Logger::NewLine;
+
+    Logger::get() << "Upload: " << portBroker.uploadPath() << Logger::NewLine
+                  << "Press Ctrl+C to stop." << Logger::NewLine;
+
+    activeBroker = &portBroker;
+    std::signal(SIGINT, stopBroker);
+    std::signal(SIGTERM, stopBroker);
+
+    bool success = portBroker.run();
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    activeBroker = nullptr;
+
+    if (portBroker.dropped() > 0)
+        Logger::get() << "Consoles missed " << size_t(portBroker.dropped()) << " bytes." << Logger::NewLine;
+
+    if (!success)
+    {
+        Logger::get() << "Broker stopped! " << portBroker.errorStr() << Logger::NewLine;
+        return -1;
+    }
+
+    device.close();
+    Logger::get().close();
+
+    return 0;
+}
+
+int printPorts()
+{
+    PortIndex index;
+
+    if (!index.scan(PortIndex::SysfsRoot))
+    {
+        Logger::get() << index.errorStr() << Logger::NewLine;
+        return -1;
+    }
+
+    if (index.ports().empty())
+    {
+        Logger::get() << "No serial ports found." << Logger::NewLine;
+        return 0;
+    }
+
+    std::vector<std::array<std::string, 5>> rows;
+    std::array<size_t, 5> widths {};
+
+    for (auto& port : index.ports())
+    {
+        std::string portPath = port.portPath;
+        if (!port.interface.empty()) portPath += ":" + port.interface;
+
+        auto& row = rows.emplace_back(std::array<std::string, 5> {
+            port.devicePath.string(),
+            port.vendorID.empty() ? "-" : port.vendorID + ":" + port.productID,
+            port.portPath.empty() ? "-" : std::string{PortIndex::PortPathScheme} + portPath,
+            port.serialNumber.empty() ? "-" : std::string{PortIndex::SerialNumberScheme} + port.serialNumber,
+            port.driver.empty() ? "-" : port.driver
+        });
+
+        for (size_t i = 0; i < row.size(); i++)
+            widths[i] = std::max(widths[i], row[i].size());
+    }
+
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        for (size_t column = 0; column < rows[i].size(); column++)
+            Logger::get() << rows[i][column] << std::string(widths[column] - rows[i][column].size() + 2, ' ');
+
+        Logger::get() << index.ports()[i].product << Logger::NewLine;
+    }
+
+    return 0;
+}
+
+// Replaces sn:// and usb:// target paths with the port they select
+bool resolveTargets(std::vector<std::filesystem::path>& targetPaths)
+{
+    if (std::none_of(targetPaths.begin(), targetPaths.end(),
+                     [](const std::filesystem::path& path) { return PortIndex::isSelector(path.string()); }))
+        return true;
+
+    PortIndex index;
+
+    if (!index.scan(PortIndex::SysfsRoot))
+    {
+        Logger::get() << index.errorStr() << Logger::NewLine;
+        return false;
+    }
+
+    for (auto& targetPath : targetPaths)
+    {
+        if (!PortIndex::isSelector(targetPath.string())) continue;
+
+        std::filesystem::path devicePath;
+
+        if (!index.resolve(targetPath.string(), devicePath))
+        {
+            Logger::get() << targetPath << ": " << index.errorStr() << Logger::NewLine;
+            return false;
+        }
+
+        targetPath = devicePath;
+    }
+
+    return true;
+}
+
+int printStatus(const std::vector<std::filesystem::path>& targetPaths)
+{
+    if (targetPaths.empty())
+    {
+        Logger::get() << "Target path not specified." << Logger::NewLine;
+        return -1;
+    }
+
+    int result = 0;
+
+    for (auto& targetPath : targetPaths)
+    {
+        SharedStatus::Snapshot snapshot;
+        SharedStatus::Error error;
+
+        if (!SharedStatus::read(targetPath.string(), snapshot, error))
+        {
+            Logger::get() << targetPath << ": " << SharedStatus::errorStr(error);
+
+            // Left odd by a transfer that was killed while publishing
+            if (error == SharedStatus::Error::UPDATE_STUCK)
+                Logger::get() << ", the transfer writing it may have been killed";
+
+            Logger::get() << Logger::NewLine;
+            result = -1;
+            continue;
+        }
+
+        Logger::get() << targetPath << ": " << XModemSender::stateStr(snapshot.state)
+                      << ", block " << size_t(snapshot.block) << "/" << size_t(snapshot.noOfBlocks)
+                      << ", " << size_t(snapshot.retries) << " retries, "
+                      << size_t(snapshot.bytesPerSecond) << " B/s, pid " << snapshot.pid;
+
+        if (snapshot.error != XModem::Error::NONE)
+            Logger::get() << ", " << XModem::errorStr(snapshot.error);
+
+        Logger::get() << Logger::NewLine;
+    }
+
+    return result;
+}
+
+int pack(const std::filesystem::path& binaryPath,
+         std::filesystem::path outputPath,
+         const int32_t& xmodemBlockSize)
+{
+    if (binaryPath.empty())
+    {
+        Logger::get() << "Binary path not specified." << Logger::NewLine;
+        return -1;
+    }
+
+    if (xmodemBlockSize < 1)
+    {
+        Logger::get() << "XMODEM Block size invalid/not specified." << Logger::NewLine;
+        return -1;
+    }
+
+    if (outputPath.empty())
+        outputPath = std::filesystem::path{binaryPath}.replace_extension(PacketFile::Extension);
+
+    PacketFile packetFile;
+
+    if (!packetFile.pack(binaryPath, outputPath, xmodemBlockSize) ||
+            !packetFile.open(outputPath))
+    {
+        Logger::get() << "Failed to pack " << binaryPath << "!"
+                      << Logger::NewLine << packetFile.errorStr()
+                      << Logger::NewLine;
+        return -1;
+    }
+
+    Logger::get() << "Packed " << binaryPath << " into " << outputPath << Logger::NewLine
+                  << "Block size: " << xmodemBlockSize << Logger::NewLine
+                  << "Blocks: " << packetFile.noOfBlocks() << Logger::NewLine
+                  << "Hash: " << PacketFile::hashStr(packetFile.hash()) << Logger::NewLine;
+
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     if (argc == 1)
@@ -262,13 +1218,32 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    bool packOnly = !std::string_view{argv[1]}.compare("pack");
+    bool downloadOnly = !std::string_view{argv[1]}.compare("download");
+    bool brokerOnly = !std::string_view{argv[1]}.compare("broker");
+    bool statusOnly = !std::string_view{argv[1]}.compare("status");
+
     SerialDevice::DeviceProperties dp;
 
-    std::filesystem::path targetPath;
+    std::vector<std::filesystem::path> targetPaths;
     std::filesystem::path binaryPath;
     std::filesystem::path logFilePath;
+    std::filesystem::path binaryLogFilePath;
+    std::filesystem::path capturePath;
+    std::filesystem::path outputPath;
 
     bool startAfterUpload = false;
+    bool stripPadding = false;
+    bool useIOUring = false;
+    bool realTime = false;
+    bool ackLatencyStats = false;
+    bool drain = false;
+    bool sharedStatus = false;
+    bool watch = false;
+    int32_t soakRuns = 0;
+    XModem::Patches patches;
+
+    RealTime::Options realTimeOptions;
 
     bool isDevPropsSetManual = false;
     bool isDevPropsSetAuto = false;
@@ -276,19 +1251,32 @@ int main(int argc, char** argv)
     int32_t xmodemMaxRetry = 10;
     int32_t xmodemBlockSize = -1;
     int32_t serialReadTimeout = 500;
+    int32_t xmodemHandshakeTimeout = -1;
+    int32_t brokerConsoles = 1;
+
+    SerialDevice::ResetSequence resetSequence;
 
-    for (int32_t i = 1; i < argc; i++)
+    for (int32_t i = (packOnly || downloadOnly || brokerOnly || statusOnly) ? 2 : 1; i < argc; i++)
     {
         switch (getArgType(argv[i]))
         {
         case ArgType::LOG_TO_FILE:
             logFilePath = argv[++i];
             break;
+        case ArgType::BINARY_LOG:
+            binaryLogFilePath = argv[++i];
+            break;
+        case ArgType::CAPTURE:
+            capturePath = argv[++i];
+            break;
         case ArgType::BINARY_PATH:
             binaryPath = argv[++i];
             break;
+        case ArgType::OUTPUT_PATH:
+            outputPath = argv[++i];
+            break;
         case ArgType::TARGET_PATH:
-            targetPath = argv[++i];
+            targetPaths.push_back(argv[++i]);
             break;  
         case ArgType::XMODEM_MAX_RETRY:
             xmodemMaxRetry = stoi_e(argv[++i]);
@@ -297,6 +1285,22 @@ int main(int argc, char** argv)
             isDevPropsSetManual = true;
             xmodemBlockSize = stoi_e(argv[++i]);
             break;
+        case ArgType::XMODEM_HANDSHAKE_TIMEOUT:
+            xmodemHandshakeTimeout = stoi_e(argv[++i]);
+
+            if (xmodemHandshakeTimeout < 0)
+            {
+                Logger::get() << "XMODEM handshake timeout invalid." << Logger::NewLine;
+                return -1;
+            }
+            break;
+        case ArgType::RESET_SEQUENCE:
+            if (!SerialDevice::parseResetSequence(argv[++i], resetSequence))
+            {
+                Logger::get() << "Invalid reset sequence " << argv[i] << Logger::NewLine;
+                return -1;
+            }
+            break;
         case ArgType::SERIAL_DEVICE_ARIES:
             isDevPropsSetAuto = true;
             break;
@@ -323,9 +1327,57 @@ int main(int argc, char** argv)
         case ArgType::SERIAL_READ_TIMEOUT:
             serialReadTimeout = stoi_e(argv[++i]);
             break;
+        case ArgType::SERIAL_IO_URING:
+            useIOUring = true;
+            break;
+        case ArgType::SERIAL_DRAIN:
+            drain = true;
+            break;
         case ArgType::START_AFTER_UPLOAD:
             startAfterUpload = true;
             break;
+        case ArgType::STRIP_PADDING:
+            stripPadding = true;
+            break;
+        case ArgType::BROKER_CONSOLES:
+            brokerConsoles = stoi_e(argv[++i]);
+            break;
+        case ArgType::REALTIME:
+            realTime = true;
+
+            if (!RealTime::parseOptions(argv[++i], realTimeOptions))
+            {
+                Logger::get() << "Invalid real-time options " << argv[i] << Logger::NewLine;
+                return -1;
+            }
+            break;
+        case ArgType::ACK_LATENCY_STATS:
+            ackLatencyStats = true;
+            break;
+        case ArgType::SHARED_STATUS:
+            sharedStatus = true;
+            break;
+        case ArgType::WATCH:
+            watch = true;
+            break;
+        case ArgType::SOAK:
+            soakRuns = stoi_e(argv[++i]);
+
+            if (soakRuns < 1)
+            {
+                Logger::get() << "Number of soak uploads invalid." << Logger::NewLine;
+                return -1;
+            }
+            break;
+        case ArgType::PATCH:
+            if (!XModem::parsePatch(argv[++i], patches.emplace_back()))
+            {
+                Logger::get() << "Invalid patch " << argv[i] << Logger::NewLine;
+                return -1;
+            }
+            break;
+        case ArgType::PRINT_PORTS:
+            return printPorts();
         case ArgType::PRINT_LICENSE:
             printLicense();
             return 0;
@@ -351,7 +1403,15 @@ int main(int argc, char** argv)
         xmodemBlockSize = ARIES_XMODEM_BLOCK_SIZE;
     }
 
-    if (!validateProps(targetPath, xmodemMaxRetry, xmodemBlockSize, serialReadTimeout, dp)) return -1;
+    if (packOnly) return pack(binaryPath, outputPath, xmodemBlockSize);
+    if (!resolveTargets(targetPaths)) return -1;
+    if (statusOnly) return printStatus(targetPaths);
+
+    // The broker never transfers anything itself
+    if (brokerOnly && xmodemBlockSize == -1)
+        xmodemBlockSize = ARIES_XMODEM_BLOCK_SIZE;
+
+    if (!validateProps(targetPaths, xmodemMaxRetry, xmodemBlockSize, serialReadTimeout, dp)) return -1;
 
     if (!logFilePath.empty())
     {
@@ -363,19 +1423,64 @@ int main(int argc, char** argv)
         }
     }
 
-    if (binaryPath.empty())
+    // Stopped, and flushed, when the process exits
+    if (!binaryLogFilePath.empty())
+    {
+        if (!BinaryLogger::get().start(binaryLogFilePath, false))
+        {
+            Logger::get() << "Unable to setup binary logging! "
+                          << BinaryLogger::get().errorStr()
+                          << Logger::NewLine;
+            return -1;
+        }
+    }
+
+    if (brokerOnly)
+        return broker(targetPaths, dp, serialReadTimeout, resetSequence, brokerConsoles);
+
+    if (downloadOnly)
+    {
+        if (outputPath.empty())
+        {
+            Logger::get() << "Output path not specified." << Logger::NewLine;
+            return -1;
+        }
+
+        if (targetPaths.size() > 1)
+        {
+            Logger::get() << "Can only download from one target at a time." << Logger::NewLine;
+            return -1;
+        }
+    }
+    else if (binaryPath.empty())
     {
         Logger::get() << "Binary path not specified." << Logger::NewLine;
         return -1;
     }
 
+    // Right after a reset the bootloader asks for the upload almost
+    // immediately, so there is no point waiting for an operator
+    XModem::Timeouts xmodemTimeouts;
+
+    if (xmodemHandshakeTimeout != -1)
+        xmodemTimeouts.handshake = xmodemHandshakeTimeout;
+    else if (!resetSequence.empty())
+        xmodemTimeouts.handshake = RESET_HANDSHAKE_TIMEOUT;
+
     Logger::get() << "vegadude " << VERSION << Logger::NewLine
                   << "<" << GIT_REPOSITORY << ">" << Logger::NewLine
                   << Logger::NewLine
-                  << "================================================" << Logger::NewLine
-                  << "Device Path: " << targetPath << Logger::NewLine
-                  << "Binary Path: " << binaryPath << Logger::NewLine
-                  << "Target device properties:" << Logger::NewLine
+                  << "================================================" << Logger::NewLine;
+
+    for (auto& targetPath : targetPaths)
+        Logger::get() << "Device Path: " << targetPath << Logger::NewLine;
+
+    if (downloadOnly)
+        Logger::get() << "Output Path: " << outputPath << Logger::NewLine;
+    else
+        Logger::get() << "Binary Path: " << binaryPath << Logger::NewLine;
+
+    Logger::get() << "Target device properties:" << Logger::NewLine
                   << "Parity: " << dp.parity << Logger::NewLine
                   << "Stop bits: " << dp.stopBits << Logger::NewLine
                   << "RTS CTS: " << dp.rtsCts << Logger::NewLine
@@ -384,34 +1489,109 @@ int main(int argc, char** argv)
                   << "Read Timeout (in milliseconds): " << serialReadTimeout << Logger::NewLine
                   << "XMODEM Block Size " << xmodemBlockSize << Logger::NewLine
                   << "XMODEM Max Retry: " << xmodemMaxRetry << Logger::NewLine
+                  << "XMODEM Handshake Timeout (in milliseconds): " << xmodemTimeouts.handshake << Logger::NewLine
+                  << "Reset sequence steps: " << resetSequence.size() << Logger::NewLine
+                  << "Real-time priority: " << (realTime ? realTimeOptions.priority : 0) << Logger::NewLine
+                  << "Drain after every packet: " << drain << Logger::NewLine
+                  << "Patches: " << patches.size() << Logger::NewLine
                   << "================================================" << Logger::NewLine << Logger::NewLine;
 
-    SerialDevice device{targetPath, dp, serialReadTimeout};
+    if (realTime) applyRealTime(realTimeOptions);
 
-    if (!device.open())
+    if (targetPaths.size() > 1 && !capturePath.empty())
     {
-        Logger::get() << "Failed to setup serial device!"
-                      << Logger::NewLine << device.errorStr()
+        Logger::get() << "Can only capture one target at a time." << Logger::NewLine;
+        return -1;
+    }
+
+    // Concurrent uploads neither drain nor record ACK latencies
+    if (targetPaths.size() > 1 && (drain || ackLatencyStats))
+    {
+        Logger::get() << "--serial-drain and --ack-latency-stats "
+                         "can only be used with a single target." << Logger::NewLine;
+        return -1;
+    }
+
+    if (targetPaths.size() > 1 && realTime)
+        Logger::get() << "Warning: images are not paged in ahead of concurrent uploads, "
+                         "--realtime only sets priority, CPU and memory locking." << Logger::NewLine;
+
+    if (watch && (downloadOnly || targetPaths.size() > 1 || !capturePath.empty() ||
+                  ReplayDevice::isReplayPath(targetPaths.front().string())))
+    {
+        Logger::get() << "Can only watch uploads to a single target, without capture or replay."
+                      << Logger::NewLine;
+        return -1;
+    }
+
+    if (soakRuns > 0 && (downloadOnly || watch || targetPaths.size() > 1 || !capturePath.empty() ||
+                         ReplayDevice::isReplayPath(targetPaths.front().string())))
+    {
+        Logger::get() << "Can only soak uploads to a single target, without watch, capture or replay."
                       << Logger::NewLine;
         return -1;
     }
 
-    XModem modem{device, xmodemMaxRetry, xmodemBlockSize};
+    if (targetPaths.size() > 1)
+        return uploadConcurrently(targetPaths, binaryPath, dp, serialReadTimeout,
+                                  xmodemMaxRetry, xmodemBlockSize, xmodemTimeouts,
+                                  resetSequence, startAfterUpload, sharedStatus, patches,
+                                  useIOUring);
+
+    const std::filesystem::path& targetPath = targetPaths.front();
+
+    Transfer options{downloadOnly, binaryPath, outputPath, startAfterUpload, stripPadding,
+                     capturePath, realTime, ackLatencyStats, drain,
+                     sharedStatus ? targetPath.string() : std::string{}, watch, soakRuns, patches};
+
+    if (ReplayDevice::isReplayPath(targetPath.string()))
+        return transferFromReplay(targetPath.string(), options, serialReadTimeout,
+                                  xmodemMaxRetry, xmodemBlockSize, xmodemTimeouts);
+
+    if (NetworkDevice::isNetworkPath(targetPath.string()))
+        return transferOverNetwork(targetPath.string(), options, dp, serialReadTimeout,
+                                   xmodemMaxRetry, xmodemBlockSize, xmodemTimeouts,
+                                   resetSequence);
+
+    std::unique_ptr<SerialDevice> device;
+
+#ifdef __linux
+    IOUring ring{8};
 
-    if (!modem.upload(binaryPath, startAfterUpload))
+    if (useIOUring)
     {
-        Logger::get() << "Failed to upload file!"
-                      << Logger::NewLine
-                      << ((modem.error() == XModem::Error::DEVICE_RELATED) ? device.errorStr() : modem.errorStr())
+        if (ring.setup())
+            device = std::make_unique<IOUringDevice>(ring, targetPath, dp, serialReadTimeout);
+        else
+            Logger::get() << ring.errorStr() << ", falling back to regular serial I/O."
+                          << Logger::NewLine;
+    }
+#else
+    if (useIOUring)
+        Logger::get() << "io_uring is not available on this platform, falling back to regular serial I/O."
+                      << Logger::NewLine;
+#endif
+
+    if (!device)
+        device = std::make_unique<SerialDevice>(targetPath, dp, serialReadTimeout);
+
+    device->setResetSequence(resetSequence);
+
+    if (!device->open())
+    {
+        Logger::get() << "Failed to setup serial device!"
+                      << Logger::NewLine << device->errorStr()
                       << Logger::NewLine;
         return -1;
     }
 
-    Logger::get() << (startAfterUpload ?
-                          "Successfully uploaded and started program!"
-                        : "Successfully uploaded program! Press enter in serial terminal to start program.");
+    CaptureDevice capture{*device};
+    if (!startCapture(capture, capturePath)) return -1;
 
-    Logger::get().close();
+    BufferedDevice bufferedDevice{capturePath.empty() ? static_cast<Device&>(*device) : capture};
 
-    return 0;
+    XModem modem{bufferedDevice, xmodemMaxRetry, xmodemBlockSize};
+    modem.setTimeouts(xmodemTimeouts);
+
+    return transfer(modem, *device, capture, options);
 }
@@ -0,0 +1,655 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "networkdevice.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+#ifndef __WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+namespace
+{
+// RFC 854
+constexpr unsigned char IAC  {255};
+constexpr unsigned char DONT {254};
+constexpr unsigned char DO   {253};
+constexpr unsigned char WONT {252};
+constexpr unsigned char WILL {251};
+constexpr unsigned char SB   {250};
+constexpr unsigned char SE   {240};
+
+constexpr unsigned char BINARY {0};
+constexpr unsigned char SUPPRESS_GO_AHEAD {3};
+
+// RFC 2217
+constexpr unsigned char COM_PORT_OPTION {44};
+constexpr unsigned char SET_BAUDRATE {1};
+constexpr unsigned char SET_DATASIZE {2};
+constexpr unsigned char SET_PARITY {3};
+constexpr unsigned char SET_STOPSIZE {4};
+constexpr unsigned char SET_CONTROL {5};
+constexpr unsigned char SERVER_OFFSET {100};
+
+constexpr unsigned char PARITY_NONE {1};
+constexpr unsigned char PARITY_EVEN {3};
+constexpr unsigned char CONTROL_NONE {1};
+constexpr unsigned char CONTROL_HARDWARE {3};
+constexpr unsigned char CONTROL_DTR_ON {8};
+constexpr unsigned char CONTROL_DTR_OFF {9};
+constexpr unsigned char CONTROL_RTS_ON {11};
+constexpr unsigned char CONTROL_RTS_OFF {12};
+
+constexpr uint32_t ALL_SETTINGS {(1 << SET_BAUDRATE) | (1 << SET_DATASIZE) |
+                                 (1 << SET_PARITY) | (1 << SET_STOPSIZE) |
+                                 (1 << SET_CONTROL)};
+}
+
+NetworkDevice::NetworkDevice(const std::string &address,
+                             const SerialDevice::DeviceProperties &deviceProperties,
+                             const int32_t &readTimeout)
+    : m_error{Error::NONE},
+      m_address{address},
+      m_deviceProperties{deviceProperties},
+      m_readTimeout{readTimeout},
+      m_protocol{Protocol::RAW},
+      m_receivedHead{0},
+      m_telnetState{TelnetState::DATA},
+      m_telnetCommand{0},
+      m_confirmedSettings{0},
+      m_comPortRefused{false}
+{}
+
+bool NetworkDevice::isNetworkPath(const std::string &path)
+{
+    return path.starts_with(TCPScheme) || path.starts_with(RFC2217Scheme);
+}
+
+const NetworkDevice::Error &NetworkDevice::error()
+{
+    return m_error;
+}
+
+std::string NetworkDevice::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case INVALID_ADDRESS:
+        return "Invalid address, expected tcp://host:port or rfc2217://host:port";
+    case RESOLVE_FAILED:
+        return "Failed to resolve host " + m_host;
+    case CONNECT_FAILED:
+        return "Failed to connect to " + m_host + ":" + m_port;
+    case NEGOTIATION_FAILED:
+        return "Server did not accept the serial port settings";
+    case RESET_FAILED:
+        return "Reset sequence needs an rfc2217:// target";
+    case READ_FAILED:
+        return "Read failed";
+    case WRITE_FAILED:
+        return "Write failed";
+    case CONNECTION_CLOSED:
+        return "Connection closed by server";
+    case NOT_SUPPORTED:
+        return "Operation not supported";
+    case DEVICE_NOT_OPEN:
+        return "Device not open";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool NetworkDevice::parseAddress()
+{
+    std::string_view address{m_address};
+
+    if (address.starts_with(TCPScheme))
+    {
+        m_protocol = Protocol::RAW;
+        address.remove_prefix(TCPScheme.size());
+    }
+    else if (address.starts_with(RFC2217Scheme))
+    {
+        m_protocol = Protocol::RFC2217;
+        address.remove_prefix(RFC2217Scheme.size());
+    }
+    else
+    {
+        return false;
+    }
+
+    size_t colon = address.rfind(':');
+
+    if (colon == std::string_view::npos || colon == 0 || colon == address.size() - 1)
+        return false;
+
+    std::string_view host = address.substr(0, colon);
+
+    // [::1]:2000
+    if (host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+
+    m_host = host;
+    m_port = address.substr(colon + 1);
+
+    return std::all_of(m_port.begin(), m_port.end(), [](const char& c) { return c >= '0' && c <= '9'; });
+}
+
+bool NetworkDevice::read(std::span<unsigned char> bytes)
+{
+    size_t filled = 0;
+
+    while (filled < bytes.size())
+    {
+        size_t bytesRead;
+
+        if (!readSome(bytes.subspan(filled), bytesRead)) return false;
+
+        if (bytesRead == 0)
+        {
+            m_error = Error::READ_FAILED;
+            return false;
+        }
+
+        filled += bytesRead;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool NetworkDevice::write(std::span<const unsigned char> bytes)
+{
+    if (m_protocol == Protocol::RAW)
+        return send(bytes);
+
+    m_outgoing.clear();
+    appendEscaped(bytes);
+    return send(m_outgoing);
+}
+
+bool NetworkDevice::readSome(std::span<unsigned char> bytes, size_t &bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_socket == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_readTimeout);
+
+    // A segment may carry nothing but telnet commands, keep waiting for data
+    while (m_receivedHead == m_received.size())
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+        if (remaining.count() <= 0)
+        {
+            m_error = Error::NONE;
+            return true;
+        }
+
+        if (!receive(remaining.count())) return false;
+    }
+
+    bytesRead = std::min(bytes.size(), m_received.size() - m_receivedHead);
+    std::copy_n(m_received.begin() + m_receivedHead, bytesRead, bytes.begin());
+    m_receivedHead += bytesRead;
+
+    if (m_receivedHead == m_received.size())
+    {
+        m_received.clear();
+        m_receivedHead = 0;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+void NetworkDevice::decode(std::span<const unsigned char> bytes)
+{
+    if (m_protocol == Protocol::RAW)
+    {
+        m_received.insert(m_received.end(), bytes.begin(), bytes.end());
+        return;
+    }
+
+    for (const unsigned char& byte : bytes)
+    {
+        switch (m_telnetState)
+        {
+        case TelnetState::DATA:
+            if (byte == IAC)
+                m_telnetState = TelnetState::COMMAND;
+            else
+                m_received.push_back(byte);
+            break;
+
+        case TelnetState::COMMAND:
+            if (byte == IAC)
+            {
+                m_received.push_back(IAC);
+                m_telnetState = TelnetState::DATA;
+            }
+            else if (byte == WILL || byte == WONT || byte == DO || byte == DONT)
+            {
+                m_telnetCommand = byte;
+                m_telnetState = TelnetState::OPTION;
+            }
+            else if (byte == SB)
+            {
+                m_subnegotiation.clear();
+                m_telnetState = TelnetState::SUBNEGOTIATION;
+            }
+            else
+            {
+                // NOP, go ahead and friends carry no meaning for us
+                m_telnetState = TelnetState::DATA;
+            }
+            break;
+
+        case TelnetState::OPTION:
+            handleOption(m_telnetCommand, byte);
+            m_telnetState = TelnetState::DATA;
+            break;
+
+        case TelnetState::SUBNEGOTIATION:
+            if (byte == IAC)
+                m_telnetState = TelnetState::SUBNEGOTIATION_COMMAND;
+            else
+                m_subnegotiation.push_back(byte);
+            break;
+
+        case TelnetState::SUBNEGOTIATION_COMMAND:
+            if (byte == IAC)
+            {
+                m_subnegotiation.push_back(IAC);
+                m_telnetState = TelnetState::SUBNEGOTIATION;
+            }
+            else
+            {
+                if (byte == SE) handleSubnegotiation();
+                m_telnetState = TelnetState::DATA;
+            }
+            break;
+        }
+    }
+}
+
+void NetworkDevice::handleOption(const unsigned char &command, const unsigned char &option)
+{
+    bool supported = option == BINARY || option == SUPPRESS_GO_AHEAD || option == COM_PORT_OPTION;
+
+    if (option == COM_PORT_OPTION && (command == DONT || command == WONT))
+        m_comPortRefused = true;
+
+    // Our own requests were sent up front, only refuse what we do not know
+    if (supported) return;
+
+    if (command == DO)
+        appendCommand(WONT, option);
+    else if (command == WILL)
+        appendCommand(DONT, option);
+}
+
+void NetworkDevice::handleSubnegotiation()
+{
+    if (m_subnegotiation.size() < 2 || m_subnegotiation[0] != COM_PORT_OPTION) return;
+
+    unsigned char reply = m_subnegotiation[1];
+
+    if (reply > SERVER_OFFSET && reply <= SERVER_OFFSET + SET_CONTROL)
+        m_confirmedSettings |= 1 << (reply - SERVER_OFFSET);
+}
+
+void NetworkDevice::appendCommand(const unsigned char &command, const unsigned char &option)
+{
+    m_outgoing.push_back(IAC);
+    m_outgoing.push_back(command);
+    m_outgoing.push_back(option);
+}
+
+void NetworkDevice::appendEscaped(std::span<const unsigned char> bytes)
+{
+    for (const unsigned char& byte : bytes)
+    {
+        m_outgoing.push_back(byte);
+        if (byte == IAC) m_outgoing.push_back(IAC);
+    }
+}
+
+void NetworkDevice::appendComPort(const unsigned char &command, std::span<const unsigned char> value)
+{
+    m_outgoing.push_back(IAC);
+    m_outgoing.push_back(SB);
+    m_outgoing.push_back(COM_PORT_OPTION);
+    m_outgoing.push_back(command);
+    appendEscaped(value);
+    m_outgoing.push_back(IAC);
+    m_outgoing.push_back(SE);
+}
+
+bool NetworkDevice::negotiate()
+{
+    m_outgoing.clear();
+
+    appendCommand(WILL, COM_PORT_OPTION);
+    appendCommand(WILL, BINARY);
+    appendCommand(DO, BINARY);
+    appendCommand(WILL, SUPPRESS_GO_AHEAD);
+    appendCommand(DO, SUPPRESS_GO_AHEAD);
+
+    uint32_t baudRate = m_deviceProperties.baudRate;
+    unsigned char baud[] {static_cast<unsigned char>(baudRate >> 24),
+                          static_cast<unsigned char>(baudRate >> 16),
+                          static_cast<unsigned char>(baudRate >> 8),
+                          static_cast<unsigned char>(baudRate)};
+    unsigned char dataSize = m_deviceProperties.bits;
+    unsigned char parity = m_deviceProperties.parity ? PARITY_EVEN : PARITY_NONE;
+    unsigned char stopSize = m_deviceProperties.stopBits;
+    unsigned char control = m_deviceProperties.rtsCts ? CONTROL_HARDWARE : CONTROL_NONE;
+
+    appendComPort(SET_BAUDRATE, baud);
+    appendComPort(SET_DATASIZE, {&dataSize, 1});
+    appendComPort(SET_PARITY, {&parity, 1});
+    appendComPort(SET_STOPSIZE, {&stopSize, 1});
+    appendComPort(SET_CONTROL, {&control, 1});
+
+    // The command buffer is reused by replies queued while decoding
+    std::vector<unsigned char> request;
+    request.swap(m_outgoing);
+
+    if (!send(request)) return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(NegotiationTimeout);
+
+    while (m_confirmedSettings != ALL_SETTINGS && !m_comPortRefused)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+        if (remaining.count() <= 0) break;
+
+        if (!receive(remaining.count())) return false;
+    }
+
+    if (m_confirmedSettings != ALL_SETTINGS)
+    {
+        m_error = Error::NEGOTIATION_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+void NetworkDevice::setResetSequence(const SerialDevice::ResetSequence &sequence)
+{
+    m_resetSequence = sequence;
+}
+
+bool NetworkDevice::reset()
+{
+    if (m_resetSequence.empty())
+    {
+        m_error = Error::NONE;
+        return true;
+    }
+
+    // A raw stream has no way to reach the modem control lines
+    if (m_protocol != Protocol::RFC2217)
+    {
+        m_error = Error::RESET_FAILED;
+        return false;
+    }
+
+    for (auto& step : m_resetSequence)
+    {
+        unsigned char control;
+
+        if (step.line == SerialDevice::LineStep::DTR)
+            control = step.asserted ? CONTROL_DTR_ON : CONTROL_DTR_OFF;
+        else
+            control = step.asserted ? CONTROL_RTS_ON : CONTROL_RTS_OFF;
+
+        m_outgoing.clear();
+        appendComPort(SET_CONTROL, {&control, 1});
+
+        std::vector<unsigned char> request;
+        request.swap(m_outgoing);
+
+        if (!send(request)) return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(step.holdTime));
+    }
+
+    // Drop whatever the target printed while booting
+    while (true)
+    {
+        m_received.clear();
+        m_receivedHead = 0;
+
+        if (!receive(0)) return false;
+        if (m_received.empty()) break;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+#ifdef __WIN32
+
+bool NetworkDevice::open()
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool NetworkDevice::close()
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool NetworkDevice::receive(const int32_t&)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool NetworkDevice::send(std::span<const unsigned char>)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+#else
+
+bool NetworkDevice::open()
+{
+    if (!parseAddress())
+    {
+        m_error = Error::INVALID_ADDRESS;
+        return false;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addresses;
+
+    if (getaddrinfo(m_host.c_str(), m_port.c_str(), &hints, &addresses) != 0)
+    {
+        m_error = Error::RESOLVE_FAILED;
+        return false;
+    }
+
+    for (addrinfo* address = addresses; address; address = address->ai_next)
+    {
+        m_socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+        if (m_socket == -1) continue;
+
+        if (connect(m_socket, address->ai_addr, address->ai_addrlen) == 0) break;
+
+        ::close(m_socket);
+        m_socket = -1;
+    }
+
+    freeaddrinfo(addresses);
+
+    if (m_socket == -1)
+    {
+        m_error = Error::CONNECT_FAILED;
+        return false;
+    }
+
+    // Packets are written whole and the reply is waited on, Nagle would
+    // only hold each one back until the previous ACK arrives
+    int noDelay = 1;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+#ifdef __APPLE__
+    int noSigPipe = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    m_received.clear();
+    m_receivedHead = 0;
+    m_telnetState = TelnetState::DATA;
+    m_confirmedSettings = 0;
+    m_comPortRefused = false;
+
+    if ((m_protocol == Protocol::RFC2217 && !negotiate()) || !reset())
+    {
+        Error error = m_error;
+        close();
+        m_error = error;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool NetworkDevice::close()
+{
+    if (m_socket == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    ::close(m_socket);
+    m_socket = -1;
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool NetworkDevice::receive(const int32_t &timeout)
+{
+    pollfd pfd{m_socket, POLLIN, 0};
+
+    int result = poll(&pfd, 1, timeout);
+
+    // Interrupted by a signal counts as nothing received yet, callers
+    // wait again for whatever is left of their timeout
+    if (result == 0 || (result < 0 && errno == EINTR))
+    {
+        m_error = Error::NONE;
+        return true;
+    }
+    else if (result < 0)
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    std::array<unsigned char, 4096> buffer;
+    ssize_t received = recv(m_socket, buffer.data(), buffer.size(), 0);
+
+    if (received < 0 && errno == EINTR)
+    {
+        m_error = Error::NONE;
+        return true;
+    }
+    else if (received < 0)
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+    else if (received == 0)
+    {
+        m_error = Error::CONNECTION_CLOSED;
+        return false;
+    }
+
+    m_outgoing.clear();
+    decode({buffer.data(), static_cast<size_t>(received)});
+
+    // Refusals for options the server asked about
+    if (!m_outgoing.empty()) return send(m_outgoing);
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool NetworkDevice::send(std::span<const unsigned char> bytes)
+{
+    if (m_socket == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    size_t sent = 0;
+
+    while (sent < bytes.size())
+    {
+        ssize_t result = ::send(m_socket, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+
+        if (result < 0 && errno == EINTR) continue;
+
+        if (result < 0)
+        {
+            m_error = Error::WRITE_FAILED;
+            return false;
+        }
+
+        sent += result;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef NETWORKDEVICE_H
+#define NETWORKDEVICE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "device.h"
+#include "serialdevice.h"
+
+// Serial port exported over the network by a serial server or ser2net.
+// tcp://host:port is a raw byte stream, rfc2217://host:port additionally
+// speaks telnet and sets up the remote port from the device properties.
+class NetworkDevice : public Device
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        INVALID_ADDRESS,
+        RESOLVE_FAILED,
+        CONNECT_FAILED,
+        NEGOTIATION_FAILED,
+        RESET_FAILED,
+        READ_FAILED,
+        WRITE_FAILED,
+        CONNECTION_CLOSED,
+        NOT_SUPPORTED,
+        DEVICE_NOT_OPEN
+    };
+
+    enum Protocol
+    {
+        RAW,
+        RFC2217
+    };
+
+    constexpr static std::string_view TCPScheme {"tcp://"};
+    constexpr static std::string_view RFC2217Scheme {"rfc2217://"};
+
+    // How long the server gets to confirm the port settings, in milliseconds
+    constexpr static int32_t NegotiationTimeout {3000};
+
+    NetworkDevice(const std::string& address,
+                  const SerialDevice::DeviceProperties& deviceProperties,
+                  const int32_t& readTimeout);
+
+    static bool isNetworkPath(const std::string& path);
+
+    const Error& error();
+    std::string errorStr();
+
+    // Fills all of bytes, fails with READ_FAILED if the server stops sending.
+    bool read(std::span<unsigned char> bytes);
+    // Every call goes out as a single send, so a packet is not split up.
+    bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    bool open();
+    bool close();
+
+    // Played over RFC 2217 after every successful open(), like
+    // SerialDevice::setResetSequence.
+    void setResetSequence(const SerialDevice::ResetSequence& sequence);
+    bool reset();
+
+private:
+
+    enum TelnetState
+    {
+        DATA,
+        COMMAND,
+        OPTION,
+        SUBNEGOTIATION,
+        SUBNEGOTIATION_COMMAND
+    };
+
+    Error m_error;
+    std::string m_address;
+    SerialDevice::DeviceProperties m_deviceProperties;
+    int32_t m_readTimeout;
+    SerialDevice::ResetSequence m_resetSequence;
+
+    Protocol m_protocol;
+    std::string m_host;
+    std::string m_port;
+    int32_t m_socket = -1;
+
+    // Data received but not read yet, with telnet commands already removed
+    std::vector<unsigned char> m_received;
+    size_t m_receivedHead;
+    std::vector<unsigned char> m_outgoing;
+
+    TelnetState m_telnetState;
+    unsigned char m_telnetCommand;
+    std::vector<unsigned char> m_subnegotiation;
+    uint32_t m_confirmedSettings;
+    bool m_comPortRefused;
+
+    bool parseAddress();
+    bool negotiate();
+    bool receive(const int32_t& timeout);
+    bool send(std::span<const unsigned char> bytes);
+
+    void decode(std::span<const unsigned char> bytes);
+    void handleOption(const unsigned char& command, const unsigned char& option);
+    void handleSubnegotiation();
+
+    void appendCommand(const unsigned char& command, const unsigned char& option);
+    void appendEscaped(std::span<const unsigned char> bytes);
+    void appendComPort(const unsigned char& command, std::span<const unsigned char> value);
+};
+
+#endif // NETWORKDEVICE_H
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "packetfile.h"
+#include "xmodemsender.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#ifndef __WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+constexpr unsigned char Magic[8] {'V', 'D', 'P', 'K', 'T', 0, 0, 0};
+
+template<typename T>
+void putLE(unsigned char* bytes, T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+        bytes[i] = value >> (i * 8);
+}
+
+template<typename T>
+T getLE(const unsigned char* bytes)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+        value |= static_cast<T>(bytes[i]) << (i * 8);
+    return value;
+}
+
+}
+
+PacketFile::PacketFile()
+    : m_error{Error::NONE},
+      m_blockSize{0},
+      m_imageSize{0},
+      m_noOfBlocks{0},
+      m_hash{0}
+{}
+
+PacketFile::~PacketFile()
+{
+    close();
+}
+
+const PacketFile::Error &PacketFile::error()
+{
+    return m_error;
+}
+
+std::string PacketFile::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case OPEN_FAILED:
+        return "Failed to open file";
+    case READ_FAILED:
+        return "Failed to read file";
+    case WRITE_FAILED:
+        return "Failed to write file";
+    case MMAP_FAILED:
+        return "Failed to map file";
+    case INVALID_FORMAT:
+        return "Not a valid packet file";
+    case INVALID_BLOCK_SIZE:
+        return "Invalid block size";
+    case HASH_MISMATCH:
+        return "Image does not match the stored hash";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+uint64_t PacketFile::generateHash(std::span<const unsigned char> bytes, uint64_t hash)
+{
+    for (auto&& byte : bytes)
+    {
+        hash ^= byte;
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+std::string PacketFile::hashStr(const uint64_t& hash)
+{
+    char str[17];
+    std::snprintf(str, sizeof(str), "%016" PRIx64, hash);
+    return str;
+}
+
+bool PacketFile::pack(const std::filesystem::path& imagePath,
+                      const std::filesystem::path& packetPath,
+                      const int32_t& blockSize)
+{
+    if (blockSize < 1)
+    {
+        m_error = Error::INVALID_BLOCK_SIZE;
+        return false;
+    }
+
+    std::ifstream image{imagePath, std::ios_base::in | std::ios_base::binary};
+
+    if (!image.is_open())
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    std::error_code sizeError;
+    auto size = std::filesystem::file_size(imagePath, sizeError);
+
+    if (sizeError)
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    std::vector<unsigned char> data(size);
+    image.read(reinterpret_cast<char*>(data.data()), data.size());
+
+    if (image.gcount() != static_cast<std::streamsize>(data.size()))
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    size_t noOfBlocks = (data.size() + blockSize - 1) / blockSize;
+    size_t packetSize = 3 + blockSize + 2;
+
+    std::vector<unsigned char> output(HeaderSize + noOfBlocks * packetSize);
+
+    std::memcpy(output.data(), Magic, sizeof(Magic));
+    putLE<uint32_t>(output.data() + 8, Version);
+    putLE<uint32_t>(output.data() + 12, blockSize);
+    putLE<uint64_t>(output.data() + 16, data.size());
+    putLE<uint64_t>(output.data() + 24, noOfBlocks);
+    putLE<uint64_t>(output.data() + 32, generateHash(data));
+
+    for (size_t i = 0; i < noOfBlocks; i++)
+    {
+        size_t offset = i * blockSize;
+        size_t count = std::min<size_t>(blockSize, data.size() - offset);
+
+        XModemSender::frame({output.data() + HeaderSize + i * packetSize, packetSize},
+                            i, {data.data() + offset, count});
+    }
+
+    std::ofstream packet{packetPath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc};
+    packet.write(reinterpret_cast<const char*>(output.data()), output.size());
+
+    if (!packet.good())
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool PacketFile::open(const std::filesystem::path& packetPath)
+{
+    close();
+
+#ifdef __WIN32
+    std::ifstream file{packetPath, std::ios_base::in | std::ios_base::binary};
+
+    if (!file.is_open())
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    std::error_code sizeError;
+    auto size = std::filesystem::file_size(packetPath, sizeError);
+
+    if (sizeError)
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    m_fileData.resize(size);
+    file.read(reinterpret_cast<char*>(m_fileData.data()), m_fileData.size());
+
+    if (file.gcount() != static_cast<std::streamsize>(m_fileData.size()))
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    m_file = m_fileData;
+#else
+    int32_t fd = ::open(packetPath.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+    {
+        ::close(fd);
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    if (static_cast<size_t>(st.st_size) < HeaderSize)
+    {
+        ::close(fd);
+        m_error = Error::INVALID_FORMAT;
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        m_error = Error::MMAP_FAILED;
+        return false;
+    }
+
+    m_file = {static_cast<const unsigned char*>(map), static_cast<size_t>(st.st_size)};
+#endif
+
+    const unsigned char* header = m_file.data();
+
+    if (m_file.size() < HeaderSize ||
+            std::memcmp(header, Magic, sizeof(Magic)) != 0 ||
+            getLE<uint32_t>(header + 8) != Version)
+    {
+        close();
+        m_error = Error::INVALID_FORMAT;
+        return false;
+    }
+
+    m_blockSize = getLE<uint32_t>(header + 12);
+    m_imageSize = getLE<uint64_t>(header + 16);
+    m_noOfBlocks = getLE<uint64_t>(header + 24);
+    m_hash = getLE<uint64_t>(header + 32);
+
+    if (m_blockSize < 1 || m_blockSize > uint32_t(std::numeric_limits<int32_t>::max()))
+    {
+        close();
+        m_error = Error::INVALID_BLOCK_SIZE;
+        return false;
+    }
+
+    // Checked by division first, so a forged block count cannot overflow the size
+    uint64_t packetSize = 3 + uint64_t(m_blockSize) + 2;
+    uint64_t packetsSize = m_file.size() - HeaderSize;
+
+    if (m_noOfBlocks > packetsSize / packetSize ||
+            packetsSize != m_noOfBlocks * packetSize ||
+            m_noOfBlocks != m_imageSize / m_blockSize + (m_imageSize % m_blockSize != 0))
+    {
+        close();
+        m_error = Error::INVALID_FORMAT;
+        return false;
+    }
+
+    if (imageHash() != m_hash)
+    {
+        close();
+        m_error = Error::HASH_MISMATCH;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+void PacketFile::close()
+{
+#ifdef __WIN32
+    m_fileData.clear();
+#else
+    if (!m_file.empty())
+        munmap(const_cast<unsigned char*>(m_file.data()), m_file.size());
+#endif
+
+    m_file = {};
+}
+
+int32_t PacketFile::blockSize()
+{
+    return m_blockSize;
+}
+
+size_t PacketFile::imageSize()
+{
+    return m_imageSize;
+}
+
+size_t PacketFile::noOfBlocks()
+{
+    return m_noOfBlocks;
+}
+
+uint64_t PacketFile::hash()
+{
+    return m_hash;
+}
+
+uint64_t PacketFile::imageHash()
+{
+    uint64_t hash = HashOffset;
+    uint64_t remaining = m_imageSize;
+
+    for (size_t i = 0; i < m_noOfBlocks; i++)
+    {
+        size_t count = std::min<uint64_t>(m_blockSize, remaining);
+        hash = generateHash(packet(i).subspan(3, count), hash);
+        remaining -= count;
+    }
+
+    return hash;
+}
+
+std::span<const unsigned char> PacketFile::packet(const size_t& index)
+{
+    size_t packetSize = 3 + m_blockSize + 2;
+    return m_file.subspan(HeaderSize + index * packetSize, packetSize);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef PACKETFILE_H
+#define PACKETFILE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Image with every XMODEM packet already framed, so repeated uploads of the
+// same firmware skip padding and CRC calculation entirely.
+//
+// Layout, integers in little endian:
+//   0  magic "VDPKT\0\0\0"
+//   8  u32 format version
+//  12  u32 block size
+//  16  u64 image size
+//  24  u64 block count
+//  32  u64 FNV-1a hash of the image
+//  40  block count packets of 3 + block size + 2 bytes each
+class PacketFile
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        OPEN_FAILED,
+        READ_FAILED,
+        WRITE_FAILED,
+        MMAP_FAILED,
+        INVALID_FORMAT,
+        INVALID_BLOCK_SIZE,
+        HASH_MISMATCH
+    };
+
+    constexpr static std::string_view Extension {".vdpkt"};
+    constexpr static uint32_t Version {1};
+    constexpr static size_t HeaderSize {40};
+    constexpr static uint64_t HashOffset {0xcbf29ce484222325};
+
+    PacketFile();
+    ~PacketFile();
+
+    PacketFile(const PacketFile&) = delete;
+    PacketFile& operator=(const PacketFile&) = delete;
+
+    const Error& error();
+    std::string errorStr();
+
+    bool pack(const std::filesystem::path& imagePath,
+              const std::filesystem::path& packetPath,
+              const int32_t& blockSize);
+
+    // Maps the file and checks the image in it against the stored hash,
+    // packets are then served straight from the mapping
+    bool open(const std::filesystem::path& packetPath);
+    void close();
+
+    int32_t blockSize();
+    size_t imageSize();
+    size_t noOfBlocks();
+    uint64_t hash();
+
+    std::span<const unsigned char> packet(const size_t& index);
+
+    // Continues from hash, so an image can be hashed in pieces
+    static uint64_t generateHash(std::span<const unsigned char> bytes, uint64_t hash = HashOffset);
+    static std::string hashStr(const uint64_t& hash);
+
+private:
+    Error m_error;
+
+    std::span<const unsigned char> m_file;
+#ifdef __WIN32
+    std::vector<unsigned char> m_fileData;
+#endif
+
+    uint32_t m_blockSize;
+    uint64_t m_imageSize;
+    uint64_t m_noOfBlocks;
+    uint64_t m_hash;
+
+    uint64_t imageHash();
+};
+
+#endif // PACKETFILE_H
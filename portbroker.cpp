@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "portbroker.h"
+#include "logger.h"
+
+#include <algorithm>
+
+#ifdef __linux
+#include <poll.h>
+#include <stdlib.h>
+#endif
+
+PortBroker::PortBroker(SerialDevice &port)
+    : m_error{Error::NONE},
+      m_port{port},
+      m_stopRequested{false},
+      m_received{0},
+      m_dropped{0},
+      m_uploading{false}
+{}
+
+PortBroker::~PortBroker()
+{
+    for (auto& console : m_consoles)
+        closeTerminal(console);
+
+    closeTerminal(m_upload);
+}
+
+const PortBroker::Error &PortBroker::error()
+{
+    return m_error;
+}
+
+std::string PortBroker::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case PTY_FAILED:
+        return "Failed to create pseudo terminal";
+    case POLL_FAILED:
+        return "Failed to wait for I/O";
+    case READ_FAILED:
+        return "Failed to read from the port, " + m_port.errorStr();
+    case WRITE_FAILED:
+        return "Failed to write to the port, " + m_port.errorStr();
+    case PORT_CLOSED:
+        return "Port was closed or disconnected";
+    case NOT_SUPPORTED:
+        return "Port broker is only supported on Linux";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+std::vector<std::string> PortBroker::consolePaths()
+{
+    std::vector<std::string> paths;
+
+    for (auto& console : m_consoles)
+        paths.push_back(console.path);
+
+    return paths;
+}
+
+const std::string &PortBroker::uploadPath()
+{
+    return m_upload.path;
+}
+
+void PortBroker::stop()
+{
+    m_stopRequested = true;
+}
+
+const uint64_t &PortBroker::dropped()
+{
+    return m_dropped;
+}
+
+#ifdef __linux
+
+bool PortBroker::setup(const size_t &noOfConsoles)
+{
+    m_ring = std::make_unique<unsigned char[]>(RingSize);
+    m_transmit.resize(WriteChunkSize);
+
+    m_consoles.resize(noOfConsoles);
+
+    for (auto& console : m_consoles)
+        if (!openTerminal(console, true)) return false;
+
+    // Not held, so the master hangs up whenever no upload is attached
+    if (!openTerminal(m_upload, false)) return false;
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool PortBroker::openTerminal(Terminal &terminal, const bool &holdSlave)
+{
+    terminal.master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (terminal.master == -1 ||
+            grantpt(terminal.master) != 0 ||
+            unlockpt(terminal.master) != 0)
+    {
+        m_error = Error::PTY_FAILED;
+        return false;
+    }
+
+    terminal.path = ptsname(terminal.master);
+    terminal.slave = ::open(terminal.path.c_str(), O_RDWR | O_NOCTTY);
+
+    termios tty;
+
+    if (terminal.slave == -1 || tcgetattr(terminal.slave, &tty) != 0)
+    {
+        m_error = Error::PTY_FAILED;
+        return false;
+    }
+
+    // Passes bytes through untouched until a client configures it
+    cfmakeraw(&tty);
+
+    if (tcsetattr(terminal.slave, TCSANOW, &tty) != 0)
+    {
+        m_error = Error::PTY_FAILED;
+        return false;
+    }
+
+    if (!holdSlave)
+    {
+        ::close(terminal.slave);
+        terminal.slave = -1;
+    }
+
+    return true;
+}
+
+void PortBroker::closeTerminal(Terminal &terminal)
+{
+    if (terminal.slave != -1) ::close(terminal.slave);
+    if (terminal.master != -1) ::close(terminal.master);
+
+    terminal.slave = -1;
+    terminal.master = -1;
+}
+
+bool PortBroker::receive()
+{
+    size_t offset = m_received % RingSize;
+    size_t bytesRead;
+
+    if (!m_port.readSome({m_ring.get() + offset, RingSize - offset}, bytesRead))
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+
+    m_received += bytesRead;
+
+    for (auto& console : m_consoles)
+    {
+        if (m_received - console.position > RingSize)
+        {
+            m_dropped += m_received - console.position - RingSize;
+            console.position = m_received - RingSize;
+        }
+    }
+
+    // A new upload only gets what arrives after it attached
+    if (!m_uploading)
+        m_upload.position = m_received;
+
+    return true;
+}
+
+bool PortBroker::forward(Terminal &terminal)
+{
+    while (true)
+    {
+        ssize_t count = ::read(terminal.master, m_transmit.data(), m_transmit.size());
+
+        // Nothing left, or the client went away
+        if (count <= 0) return true;
+
+        if (!m_port.write({m_transmit.data(), size_t(count)}))
+        {
+            m_error = Error::WRITE_FAILED;
+            return false;
+        }
+    }
+}
+
+bool PortBroker::flush(Terminal &terminal)
+{
+    while (terminal.position < m_received)
+    {
+        size_t offset = terminal.position % RingSize;
+        size_t count = std::min<uint64_t>(m_received - terminal.position, RingSize - offset);
+
+        ssize_t written = ::write(terminal.master, m_ring.get() + offset, count);
+
+        // The terminal is full, the rest goes out once it drains
+        if (written <= 0) return false;
+
+        terminal.position += written;
+    }
+
+    return true;
+}
+
+void PortBroker::checkUpload()
+{
+    pollfd upload {m_upload.master, 0, 0};
+    poll(&upload, 1, 0);
+
+    bool attached = !(upload.revents & POLLHUP);
+
+    if (attached && !m_uploading)
+    {
+        m_uploading = true;
+        m_upload.position = m_received;
+        Logger::get() << "Upload attached, console input paused" << Logger::NewLine;
+    }
+    else if (!attached && m_uploading)
+    {
+        m_uploading = false;
+        Logger::get() << "Upload detached, console input resumed" << Logger::NewLine;
+    }
+}
+
+bool PortBroker::run()
+{
+    m_stopRequested = false;
+
+    std::vector<pollfd> fds;
+    fds.reserve(m_consoles.size() + 2);
+
+    while (!m_stopRequested)
+    {
+        checkUpload();
+
+        fds.clear();
+        fds.push_back({m_port.linuxFD(), POLLIN, 0});
+
+        for (auto& console : m_consoles)
+        {
+            short events = (m_uploading ? 0 : POLLIN) |
+                    (console.position < m_received ? POLLOUT : 0);
+            fds.push_back({console.master, events, 0});
+        }
+
+        if (m_uploading)
+            fds.push_back({m_upload.master, short(POLLIN | (m_upload.position < m_received ? POLLOUT : 0)), 0});
+
+        // A detached upload terminal always reports a hang up, so it is
+        // checked on a timer instead
+        if (poll(fds.data(), fds.size(), m_uploading ? -1 : AttachInterval) == -1)
+        {
+            if (errno == EINTR) continue;
+
+            m_error = Error::POLL_FAILED;
+            return false;
+        }
+
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            m_error = Error::PORT_CLOSED;
+            return false;
+        }
+
+        if ((fds[0].revents & POLLIN) && !receive()) return false;
+
+        for (size_t i = 0; i < m_consoles.size(); i++)
+            if ((fds[i + 1].revents & POLLIN) && !forward(m_consoles[i])) return false;
+
+        if (m_uploading && (fds.back().revents & POLLIN) && !forward(m_upload)) return false;
+
+        for (auto& console : m_consoles)
+            flush(console);
+
+        if (m_uploading)
+            flush(m_upload);
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+#else
+
+bool PortBroker::setup(const size_t &)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool PortBroker::openTerminal(Terminal &, const bool &)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+void PortBroker::closeTerminal(Terminal &)
+{}
+
+bool PortBroker::receive()
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool PortBroker::forward(Terminal &)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool PortBroker::flush(Terminal &)
+{
+    return false;
+}
+
+void PortBroker::checkUpload()
+{}
+
+bool PortBroker::run()
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+#endif
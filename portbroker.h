@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PORTBROKER_H
+#define PORTBROKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "serialdevice.h"
+
+// Owns a serial port and shares it through pseudo terminals, so that
+// consoles stay attached while the target is flashed (Linux only).
+//
+// Everything the target sends is read once into a ring and written from
+// there to every attached terminal, each keeping its own position in it.
+// A console that stops reading loses the oldest output once it falls a
+// whole ring behind, instead of holding up the port.
+//
+// An upload is a client opening the upload terminal. From then until it
+// closes it, only the upload terminal may write to the port, input typed
+// into consoles waits in their terminals.
+class PortBroker
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        PTY_FAILED,
+        POLL_FAILED,
+        READ_FAILED,
+        WRITE_FAILED,
+        PORT_CLOSED,
+        NOT_SUPPORTED
+    };
+
+    constexpr static size_t RingSize {1024 * 1024};
+    constexpr static size_t WriteChunkSize {4096};
+    // How often a detached upload terminal is checked for a new client
+    constexpr static int32_t AttachInterval {10};
+
+    PortBroker(SerialDevice& port);
+    ~PortBroker();
+
+    PortBroker(const PortBroker&) = delete;
+    PortBroker& operator=(const PortBroker&) = delete;
+
+    const Error& error();
+    std::string errorStr();
+
+    // Creates noOfConsoles console terminals and the upload terminal
+    bool setup(const size_t& noOfConsoles);
+
+    std::vector<std::string> consolePaths();
+    const std::string& uploadPath();
+
+    // Serves the port until stop() is called or it fails
+    bool run();
+    // Safe to call from a signal handler
+    void stop();
+
+    // Bytes consoles missed because they did not read in time
+    const uint64_t& dropped();
+
+private:
+    struct Terminal
+    {
+        int32_t master = -1;
+        // Held open for consoles, so they can be closed and reopened freely
+        int32_t slave = -1;
+        std::string path;
+        // Position in the ring, in bytes received since the start
+        uint64_t position = 0;
+    };
+
+    Error m_error;
+    SerialDevice& m_port;
+    std::atomic<bool> m_stopRequested;
+
+    std::unique_ptr<unsigned char[]> m_ring;
+    uint64_t m_received;
+    uint64_t m_dropped;
+
+    std::vector<Terminal> m_consoles;
+    Terminal m_upload;
+    bool m_uploading;
+
+    std::vector<unsigned char> m_transmit;
+
+    bool openTerminal(Terminal& terminal, const bool& holdSlave);
+    void closeTerminal(Terminal& terminal);
+
+    bool receive();
+    bool forward(Terminal& terminal);
+    bool flush(Terminal& terminal);
+    void checkUpload();
+};
+
+#endif // PORTBROKER_H
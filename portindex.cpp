@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "portindex.h"
+
+#include <algorithm>
+
+#ifdef __linux
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+#ifdef __linux
+
+// Closes the descriptor it holds when replaced or destroyed
+class Descriptor
+{
+public:
+    Descriptor(const int& fd) : m_fd{fd} {}
+    ~Descriptor() { if (m_fd != -1) ::close(m_fd); }
+
+    Descriptor(const Descriptor&) = delete;
+    Descriptor& operator=(const Descriptor&) = delete;
+
+    void reset(const int& fd)
+    {
+        if (m_fd != -1) ::close(m_fd);
+        m_fd = fd;
+    }
+
+    const int& fd() { return m_fd; }
+
+private:
+    int m_fd;
+};
+
+// Directories are opened as paths only, to look things up relative to them
+int openDirectory(const int& directoryFD, const char* name)
+{
+    return openat(directoryFD, name, O_PATH | O_DIRECTORY | O_CLOEXEC);
+}
+
+// Contents of a sysfs attribute without the trailing newline, empty if missing
+std::string readAttribute(const int& directoryFD, const char* name)
+{
+    Descriptor attribute{openat(directoryFD, name, O_RDONLY | O_CLOEXEC)};
+    if (attribute.fd() == -1) return {};
+
+    char buffer[256];
+    ssize_t length = ::read(attribute.fd(), buffer, sizeof(buffer));
+
+    if (length <= 0) return {};
+
+    std::string value{buffer, size_t(length)};
+
+    while (!value.empty() && (value.back() == '\n' || value.back() == ' '))
+        value.pop_back();
+
+    return value;
+}
+
+std::string readLink(const int& directoryFD, const char* name)
+{
+    char buffer[4096];
+    ssize_t length = readlinkat(directoryFD, name, buffer, sizeof(buffer));
+
+    return length <= 0 ? std::string{} : std::string{buffer, size_t(length)};
+}
+
+#endif
+
+// Orders ttyUSB2 before ttyUSB10
+bool lessByName(const PortIndex::Port& a, const PortIndex::Port& b)
+{
+    size_t aDigits = a.name.find_last_not_of("0123456789") + 1;
+    size_t bDigits = b.name.find_last_not_of("0123456789") + 1;
+
+    int prefix = a.name.compare(0, aDigits, b.name, 0, bDigits);
+    if (prefix != 0) return prefix < 0;
+
+    if (a.name.size() - aDigits != b.name.size() - bDigits)
+        return a.name.size() - aDigits < b.name.size() - bDigits;
+
+    return a.name < b.name;
+}
+
+}
+
+PortIndex::PortIndex()
+    : m_error{Error::NONE}
+{}
+
+const PortIndex::Error &PortIndex::error()
+{
+    return m_error;
+}
+
+std::string PortIndex::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case SCAN_FAILED:
+        return "Failed to read serial ports from sysfs";
+    case NOT_FOUND:
+        return "No serial port matches";
+    case AMBIGUOUS:
+        return "More than one serial port matches";
+    case NOT_SUPPORTED:
+        return "Finding boards is only supported on Linux";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+const std::vector<PortIndex::Port> &PortIndex::ports()
+{
+    return m_ports;
+}
+
+bool PortIndex::isSelector(const std::string &targetPath)
+{
+    return targetPath.starts_with(SerialNumberScheme) || targetPath.starts_with(PortPathScheme);
+}
+
+bool PortIndex::resolve(const std::string &selector, std::filesystem::path &devicePath)
+{
+    if (selector.starts_with(SerialNumberScheme))
+        return find(m_bySerialNumber, selector.substr(SerialNumberScheme.size()), devicePath);
+
+    if (selector.starts_with(PortPathScheme))
+        return find(m_byPortPath, selector.substr(PortPathScheme.size()), devicePath);
+
+    m_error = Error::NOT_FOUND;
+    return false;
+}
+
+bool PortIndex::find(const std::unordered_multimap<std::string, size_t> &index,
+                     const std::string &key,
+                     std::filesystem::path &devicePath)
+{
+    auto [first, last] = index.equal_range(key);
+
+    if (first == last)
+    {
+        m_error = Error::NOT_FOUND;
+        return false;
+    }
+
+    if (std::next(first) != last)
+    {
+        m_error = Error::AMBIGUOUS;
+        return false;
+    }
+
+    devicePath = m_ports[first->second].devicePath;
+
+    m_error = Error::NONE;
+    return true;
+}
+
+#ifdef __linux
+
+bool PortIndex::scan(const std::filesystem::path &root)
+{
+    m_ports.clear();
+    m_bySerialNumber.clear();
+    m_byPortPath.clear();
+
+    std::error_code error;
+
+    for (std::filesystem::directory_iterator entry{root, error};
+         !error && entry != std::filesystem::directory_iterator{};
+         entry.increment(error))
+    {
+        Port port;
+        if (readPort(entry->path(), port)) m_ports.push_back(std::move(port));
+    }
+
+    if (error)
+    {
+        m_error = Error::SCAN_FAILED;
+        return false;
+    }
+
+    std::sort(m_ports.begin(), m_ports.end(), lessByName);
+
+    for (size_t i = 0; i < m_ports.size(); i++)
+    {
+        const Port& port = m_ports[i];
+
+        if (!port.serialNumber.empty())
+        {
+            m_bySerialNumber.emplace(port.serialNumber, i);
+
+            if (!port.interface.empty())
+                m_bySerialNumber.emplace(port.serialNumber + ":" + port.interface, i);
+        }
+
+        if (!port.portPath.empty())
+        {
+            m_byPortPath.emplace(port.portPath, i);
+
+            if (!port.interface.empty())
+                m_byPortPath.emplace(port.portPath + ":" + port.interface, i);
+        }
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool PortIndex::readPort(const std::filesystem::path &classPath, Port &port)
+{
+    // Every lookup is made relative to a directory that is already open,
+    // walking the deep sysfs paths from the root each time would take most
+    // of the scan. Paths are only worked out to name the port path.
+    Descriptor tty{::open(classPath.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)};
+    if (tty.fd() == -1) return false;
+
+    // Virtual terminals and pseudo terminals have no device behind them
+    std::string deviceLink = readLink(tty.fd(), "device");
+    if (deviceLink.empty()) return false;
+
+    // Legacy 8250 ports are registered whether or not the UART exists
+    if (readAttribute(tty.fd(), "type") == "0") return false;
+
+    Descriptor current{openDirectory(tty.fd(), "device")};
+    if (current.fd() == -1) return false;
+
+    port.name = classPath.filename().string();
+    port.devicePath = std::filesystem::path{"/dev"} / port.name;
+    port.driver = std::filesystem::path{readLink(current.fd(), "driver")}.filename().string();
+
+    std::string classLink = readLink(AT_FDCWD, classPath.c_str());
+    std::filesystem::path directory = classLink.empty() ? classPath : classPath.parent_path() / classLink;
+    directory = (directory / deviceLink).lexically_normal();
+
+    // The USB device is the first parent with a vendor ID, the directory
+    // below it is the interface the tty belongs to
+    std::filesystem::path child;
+
+    while (current.fd() != -1 && directory.has_relative_path())
+    {
+        std::string vendorID = readAttribute(current.fd(), "idVendor");
+
+        if (vendorID.empty())
+        {
+            current.reset(openDirectory(current.fd(), ".."));
+            child = directory;
+            directory = directory.parent_path();
+            continue;
+        }
+
+        port.vendorID = vendorID;
+        port.productID = readAttribute(current.fd(), "idProduct");
+        port.serialNumber = readAttribute(current.fd(), "serial");
+        port.product = readAttribute(current.fd(), "product");
+        port.portPath = directory.filename().string();
+
+        std::string interface = child.filename().string();
+        if (interface.starts_with(port.portPath + ":"))
+            port.interface = interface.substr(port.portPath.size() + 1);
+
+        break;
+    }
+
+    return true;
+}
+
+#else
+
+bool PortIndex::scan(const std::filesystem::path&)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool PortIndex::readPort(const std::filesystem::path&, Port&)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef PORTINDEX_H
+#define PORTINDEX_H
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Index of the serial ports on this machine, read straight from sysfs
+// (Linux only), so that boards can be found by what they are instead of by
+// the ttyUSB number they got on the last plug in.
+//
+// USB ports carry the vendor and product ID, serial number and the path of
+// physical ports from the root hub down to the board, e.g. 1-1.4.2 for
+// port 2 of the hub on port 4 of the hub on port 1 of bus 1. The port path
+// stays the same for a socket as long as the hubs are not rearranged.
+class PortIndex
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        SCAN_FAILED,
+        NOT_FOUND,
+        AMBIGUOUS,
+        NOT_SUPPORTED
+    };
+
+    struct Port
+    {
+        std::string name;                   // ttyUSB0
+        std::filesystem::path devicePath;   // /dev/ttyUSB0
+        std::string driver;                 // ftdi_sio, cdc_acm, ...
+        std::string vendorID;               // 4 hex digits, empty if not USB
+        std::string productID;
+        std::string serialNumber;
+        std::string portPath;
+        std::string interface;              // configuration.interface, e.g. 1.0
+        std::string product;
+    };
+
+    constexpr static std::string_view SysfsRoot {"/sys/class/tty"};
+
+    // Target paths that select a board by serial number or port path
+    constexpr static std::string_view SerialNumberScheme {"sn://"};
+    constexpr static std::string_view PortPathScheme {"usb://"};
+
+    PortIndex();
+
+    const Error& error();
+    std::string errorStr();
+
+    // Reads every tty in root that is backed by a device
+    bool scan(const std::filesystem::path& root);
+
+    const std::vector<Port>& ports();
+
+    static bool isSelector(const std::string& targetPath);
+
+    // Finds the device for an sn:// or usb:// target path
+    bool resolve(const std::string& selector, std::filesystem::path& devicePath);
+
+private:
+    Error m_error;
+    std::vector<Port> m_ports;
+
+    // Indices into m_ports. Serial numbers can repeat on cheap adapters,
+    // and the ports of one multi-port adapter share both serial number and
+    // port path, so each is also indexed with :interface appended.
+    std::unordered_multimap<std::string, size_t> m_bySerialNumber;
+    std::unordered_multimap<std::string, size_t> m_byPortPath;
+
+    bool find(const std::unordered_multimap<std::string, size_t>& index,
+              const std::string& key,
+              std::filesystem::path& devicePath);
+
+    bool readPort(const std::filesystem::path& classPath, Port& port);
+};
+
+#endif // PORTINDEX_H
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "realtime.h"
+
+#include <cerrno>
+#include <charconv>
+#include <string_view>
+
+namespace
+{
+
+bool parseNumber(std::string_view text, int32_t& value)
+{
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size();
+}
+
+}
+
+bool RealTime::parseOptions(const std::string &str, Options &options)
+{
+    size_t separator = str.find(':');
+
+    if (!parseNumber(std::string_view{str}.substr(0, separator), options.priority))
+        return false;
+
+    options.cpu = -1;
+
+    if (separator != std::string::npos &&
+            (!parseNumber(std::string_view{str}.substr(separator + 1), options.cpu) || options.cpu < 0))
+        return false;
+
+    return options.priority > 0;
+}
+
+RealTime::RealTime()
+    : m_error{Error::NONE}
+{}
+
+const RealTime::Error &RealTime::error()
+{
+    return m_error;
+}
+
+std::string RealTime::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case INVALID_PRIORITY:
+        return "Priority is out of range for SCHED_FIFO";
+    case INVALID_CPU:
+        return "CPU does not exist or is offline";
+    case PERMISSION_DENIED:
+        return "Permission denied, needs root or CAP_SYS_NICE / CAP_IPC_LOCK";
+    case PRIORITY_FAILED:
+        return "Failed to set thread priority";
+    case AFFINITY_FAILED:
+        return "Failed to set thread affinity";
+    case LOCK_FAILED:
+        return "Failed to lock memory, RLIMIT_MEMLOCK may be too low";
+    case NOT_SUPPORTED:
+        return "Not supported on this platform";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+#if defined(__linux) || defined(__APPLE__)
+bool RealTime::setPriority(const int32_t &priority)
+{
+    if (priority < sched_get_priority_min(SCHED_FIFO) ||
+            priority > sched_get_priority_max(SCHED_FIFO))
+    {
+        m_error = Error::INVALID_PRIORITY;
+        return false;
+    }
+
+    sched_param param {};
+    param.sched_priority = priority;
+
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    if (result != 0)
+    {
+        m_error = (result == EPERM) ? Error::PERMISSION_DENIED : Error::PRIORITY_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+#elif __WIN32
+bool RealTime::setPriority(const int32_t &)
+{
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        m_error = Error::PRIORITY_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+#endif
+
+#ifdef __linux
+bool RealTime::pinToCPU(const int32_t &cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+        m_error = Error::INVALID_CPU;
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    if (result != 0)
+    {
+        m_error = (result == EINVAL) ? Error::INVALID_CPU : Error::AFFINITY_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool RealTime::lockMemory()
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        m_error = (errno == EPERM) ? Error::PERMISSION_DENIED : Error::LOCK_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+#elif __WIN32
+bool RealTime::pinToCPU(const int32_t &cpu)
+{
+    if (cpu < 0 || cpu >= 64)
+    {
+        m_error = Error::INVALID_CPU;
+        return false;
+    }
+
+    if (!SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu))
+    {
+        m_error = Error::AFFINITY_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool RealTime::lockMemory()
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+#elif __APPLE__
+bool RealTime::pinToCPU(const int32_t &)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+bool RealTime::lockMemory()
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+#endif
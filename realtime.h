@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstdint>
+#include <string>
+
+#ifdef __linux
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#elif __WIN32
+#include <Windows.h>
+#elif __APPLE__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Keeps the calling thread from being descheduled or page faulting while
+// it talks to the target. Every step can fail on its own, usually for lack
+// of privileges, and leaves the thread as it was.
+class RealTime
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        INVALID_PRIORITY,
+        INVALID_CPU,
+        PERMISSION_DENIED,
+        PRIORITY_FAILED,
+        AFFINITY_FAILED,
+        LOCK_FAILED,
+        NOT_SUPPORTED
+    };
+
+    struct Options
+    {
+        int32_t priority = DefaultPriority;
+        int32_t cpu = -1;   // -1 leaves the thread on any CPU
+    };
+
+    constexpr static int32_t DefaultPriority {50};
+
+    // Parses priority, optionally followed by :cpu, e.g. "80" or "80:3"
+    static bool parseOptions(const std::string& str, Options& options);
+
+    RealTime();
+
+    const Error& error();
+    std::string errorStr();
+
+    // SCHED_FIFO at priority
+    bool setPriority(const int32_t& priority);
+    bool pinToCPU(const int32_t& cpu);
+    // Locks every current and future page of the process into memory
+    bool lockMemory();
+
+private:
+    Error m_error;
+};
+
+#endif // REALTIME_H
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "replaydevice.h"
+
+#include <algorithm>
+#include <thread>
+
+bool ReplayDevice::isReplayPath(std::string_view path)
+{
+    return path.starts_with(Scheme);
+}
+
+ReplayDevice::ReplayDevice(const std::filesystem::path &capturePath,
+                           const int32_t &readTimeout,
+                           const double &timeScale)
+    : m_error{Error::NONE},
+      m_capturePath{capturePath},
+      m_readTimeout{readTimeout},
+      m_timeScale{timeScale},
+      m_open{false},
+      m_next{0},
+      m_offset{0},
+      m_divergences{0},
+      m_anchorTimestamp{0}
+{
+    std::string path = m_capturePath.string();
+
+    if (isReplayPath(path))
+        m_capturePath = path.substr(Scheme.size());
+}
+
+const ReplayDevice::Error &ReplayDevice::error()
+{
+    return m_error;
+}
+
+std::string ReplayDevice::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case READ_FAILED:
+        return "Failed to read capture file";
+    case INVALID_FORMAT:
+        return "Not a vegadude capture file";
+    case DEVICE_NOT_OPEN:
+        return "Replay is not open";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool ReplayDevice::open()
+{
+    CaptureDevice::Error error;
+
+    if (!CaptureDevice::load(m_capturePath, m_records, error))
+    {
+        m_error = (error == CaptureDevice::Error::INVALID_FORMAT) ?
+                    Error::INVALID_FORMAT : Error::READ_FAILED;
+        return false;
+    }
+
+    m_next = 0;
+    m_offset = 0;
+    m_divergences = 0;
+    m_anchor = Clock::now();
+    m_anchorTimestamp = 0;
+    m_open = true;
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool ReplayDevice::close()
+{
+    m_open = false;
+    m_error = Error::NONE;
+    return true;
+}
+
+bool ReplayDevice::pending(const CaptureDevice::Direction &direction)
+{
+    return m_next < m_records.size() && m_records[m_next].direction == direction;
+}
+
+void ReplayDevice::advance(const size_t &count)
+{
+    m_offset += count;
+
+    if (m_offset == m_records[m_next].bytes.size())
+    {
+        m_next++;
+        m_offset = 0;
+    }
+}
+
+ReplayDevice::Clock::duration ReplayDevice::scaled(const Clock::duration &duration)
+{
+    return std::chrono::duration_cast<Clock::duration>(duration * m_timeScale);
+}
+
+bool ReplayDevice::read(std::span<unsigned char> bytes)
+{
+    size_t filled = 0;
+
+    while (filled < bytes.size())
+    {
+        size_t bytesRead;
+        if (!readSome(bytes.subspan(filled), bytesRead)) return false;
+        if (bytesRead == 0) break;
+
+        filled += bytesRead;
+    }
+
+    return true;
+}
+
+bool ReplayDevice::readSome(std::span<unsigned char> bytes, size_t &bytesRead)
+{
+    bytesRead = 0;
+
+    if (!m_open)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    Clock::duration timeout = scaled(std::chrono::milliseconds(m_readTimeout));
+
+    // The target stays quiet until the host writes what it is waiting for
+    if (!pending(CaptureDevice::RX))
+    {
+        std::this_thread::sleep_for(timeout);
+        return true;
+    }
+
+    const CaptureDevice::Record& record = m_records[m_next];
+
+    uint64_t delay = record.timestamp - std::min(record.timestamp, m_anchorTimestamp);
+    Clock::time_point due = m_anchor + scaled(std::chrono::nanoseconds(delay));
+    Clock::time_point now = Clock::now();
+
+    if (due - now > timeout)
+    {
+        std::this_thread::sleep_for(timeout);
+        return true;
+    }
+
+    std::this_thread::sleep_until(due);
+
+    bytesRead = std::min(bytes.size(), record.bytes.size() - m_offset);
+    std::copy_n(record.bytes.begin() + m_offset, bytesRead, bytes.begin());
+    advance(bytesRead);
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool ReplayDevice::write(std::span<const unsigned char> bytes)
+{
+    if (!m_open)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    bool matched = true;
+    size_t written = 0;
+
+    while (written < bytes.size() && pending(CaptureDevice::TX))
+    {
+        const CaptureDevice::Record& record = m_records[m_next];
+        size_t count = std::min(bytes.size() - written, record.bytes.size() - m_offset);
+
+        if (!std::equal(bytes.begin() + written, bytes.begin() + written + count,
+                        record.bytes.begin() + m_offset))
+            matched = false;
+
+        m_anchorTimestamp = record.timestamp;
+        advance(count);
+        written += count;
+    }
+
+    if (!matched || written < bytes.size())
+        m_divergences++;
+
+    m_anchor = Clock::now();
+
+    m_error = Error::NONE;
+    return true;
+}
+
+const size_t &ReplayDevice::divergences()
+{
+    return m_divergences;
+}
+
+uint64_t ReplayDevice::duration()
+{
+    return m_records.empty() ? 0 : m_records.back().timestamp;
+}
+
+const std::vector<CaptureDevice::Record> &ReplayDevice::records()
+{
+    return m_records;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef REPLAYDEVICE_H
+#define REPLAYDEVICE_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "capturedevice.h"
+
+// Plays the target's side of a capture back to the host. Every reply is
+// held back by as long as the target originally took after the host's
+// previous write, so the host sees the same timing as on the real wire.
+// What the host writes is compared against the capture, and any difference
+// is counted as a divergence instead of failing the transfer.
+class ReplayDevice : public Device
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        READ_FAILED,
+        INVALID_FORMAT,
+        DEVICE_NOT_OPEN
+    };
+
+    constexpr static std::string_view Scheme {"replay://"};
+
+    static bool isReplayPath(std::string_view path);
+
+    // timeScale stretches every wait, 0 replays as fast as possible
+    ReplayDevice(const std::filesystem::path& capturePath,
+                 const int32_t& readTimeout,
+                 const double& timeScale = 1.0);
+
+    const Error& error();
+    std::string errorStr();
+
+    bool open();
+    bool close();
+
+    bool read(std::span<unsigned char> bytes);
+    bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    // Writes that did not match the capture
+    const size_t& divergences();
+    // Length of the original capture, in nanoseconds
+    uint64_t duration();
+    const std::vector<CaptureDevice::Record>& records();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Error m_error;
+    std::filesystem::path m_capturePath;
+    int32_t m_readTimeout;
+    double m_timeScale;
+    bool m_open;
+
+    std::vector<CaptureDevice::Record> m_records;
+    size_t m_next;
+    size_t m_offset;
+    size_t m_divergences;
+
+    // Replies are timed from the host's last write, which stands in for
+    // the record at m_anchorTimestamp
+    Clock::time_point m_anchor;
+    uint64_t m_anchorTimestamp;
+
+    bool pending(const CaptureDevice::Direction& direction);
+    void advance(const size_t& count);
+    Clock::duration scaled(const Clock::duration& duration);
+};
+
+#endif // REPLAYDEVICE_H
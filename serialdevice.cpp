@@ -13,6 +13,8 @@
 
 #include "serialdevice.h"
 
+#include <charconv>
+
 SerialDevice::SerialDevice(const std::filesystem::path& devicePath,
                            const DeviceProperties& deviceProperties,
                            const int32_t& readTimeout)
@@ -49,11 +51,114 @@ std::string SerialDevice::errorStr()
         return "Write failed";
     case DEVICE_NOT_OPEN:
         return "Device not open";
+    case RESET_FAILED:
+        return "Failed to toggle DTR/RTS to reset target";
+    case DRAIN_FAILED:
+        return "Failed to wait for pending output to be transmitted";
     }
 
     return "Unknown error " + std::to_string(m_error);
 }
 
+bool SerialDevice::parseResetSequence(const std::string& str, ResetSequence& sequence)
+{
+    sequence.clear();
+
+    size_t start = 0;
+
+    while (start < str.size())
+    {
+        size_t end = str.find(',', start);
+        if (end == std::string::npos) end = str.size();
+
+        std::string step = str.substr(start, end - start);
+        start = end + 1;
+
+        size_t equals = step.find('=');
+        size_t colon = step.find(':');
+
+        if (equals == std::string::npos || colon == std::string::npos || colon < equals)
+            return false;
+
+        std::string line = step.substr(0, equals);
+        std::string level = step.substr(equals + 1, colon - equals - 1);
+
+        LineStep lineStep;
+
+        if (line == "dtr")
+            lineStep.line = LineStep::DTR;
+        else if (line == "rts")
+            lineStep.line = LineStep::RTS;
+        else
+            return false;
+
+        if (level == "1")
+            lineStep.asserted = true;
+        else if (level == "0")
+            lineStep.asserted = false;
+        else
+            return false;
+
+        std::string_view holdTime = std::string_view{step}.substr(colon + 1);
+        auto [parsed, error] = std::from_chars(holdTime.data(), holdTime.data() + holdTime.size(),
+                                               lineStep.holdTime);
+
+        if (error != std::errc{} || parsed != holdTime.data() + holdTime.size() || lineStep.holdTime < 0)
+            return false;
+
+        sequence.push_back(lineStep);
+    }
+
+    return !sequence.empty();
+}
+
+std::chrono::microseconds SerialDevice::transmitTime(const size_t& bytes)
+{
+    if (m_deviceProperties.baudRate <= 0) return std::chrono::microseconds{0};
+
+    // Start bit, data bits, parity bit and stop bits of every character
+    int64_t characterBits = 1 + m_deviceProperties.bits +
+            (m_deviceProperties.parity ? 1 : 0) + m_deviceProperties.stopBits;
+
+    return std::chrono::microseconds(int64_t(bytes) * characterBits * 1000000 /
+                                     m_deviceProperties.baudRate);
+}
+
+void SerialDevice::setResetSequence(const ResetSequence& sequence)
+{
+    m_resetSequence = sequence;
+}
+
+bool SerialDevice::reset()
+{
+    if (m_resetSequence.empty())
+    {
+        m_error = Error::NONE;
+        return true;
+    }
+
+    for (auto& step : m_resetSequence)
+    {
+        if (!setLine(step.line, step.asserted))
+        {
+            m_error = Error::RESET_FAILED;
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(step.holdTime));
+    }
+
+    // Whatever the target printed while booting is not part of the transfer
+    if (!flushInput())
+    {
+        m_error = Error::RESET_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
 #ifdef __linux
 
 bool SerialDevice::open()
@@ -200,8 +305,7 @@ bool SerialDevice::open()
 
     if (!ioctl(m_linuxFD, TCSETS, &tty))
     {
-        m_error = Error::NONE;
-        return true;
+        return reset();
     }
     else
     {
@@ -248,6 +352,31 @@ bool SerialDevice::read(std::span<unsigned char> bytes)
     }
 }
 
+bool SerialDevice::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    ssize_t result = ::read(m_linuxFD, bytes.data(), bytes.size());
+
+    if (result != -1)
+    {
+        bytesRead = result;
+        m_error = Error::NONE;
+        return true;
+    }
+    else
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+}
+
 bool SerialDevice::write(std::span<const unsigned char> bytes)
 {
     if (m_linuxFD == -1)
@@ -272,6 +401,50 @@ bool SerialDevice::write(std::span<const unsigned char> bytes)
     return false;
 }
 
+bool SerialDevice::setLine(const LineStep::Line& line, const bool& asserted)
+{
+    int bits = (line == LineStep::DTR) ? TIOCM_DTR : TIOCM_RTS;
+    return ioctl(m_linuxFD, asserted ? TIOCMBIS : TIOCMBIC, &bits) == 0;
+}
+
+bool SerialDevice::flushInput()
+{
+    return ioctl(m_linuxFD, TCFLSH, TCIFLUSH) == 0;
+}
+
+std::chrono::microseconds SerialDevice::pendingTransmitTime()
+{
+    int queued = 0;
+
+    if (m_linuxFD == -1 || ioctl(m_linuxFD, TIOCOUTQ, &queued) != 0 || queued <= 0)
+        return std::chrono::microseconds{0};
+
+    return transmitTime(queued);
+}
+
+bool SerialDevice::drain()
+{
+    if (m_linuxFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    if (tcdrain(m_linuxFD) != 0)
+    {
+        m_error = Error::DRAIN_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
+const int32_t &SerialDevice::linuxFD()
+{
+    return m_linuxFD;
+}
+
 #elif __WIN32
 
 bool SerialDevice::open()
@@ -332,8 +505,7 @@ bool SerialDevice::open()
         return false;
     }
 
-    m_error = Error::NONE;
-    return true;
+    return reset();
 }
 
 bool SerialDevice::close()
@@ -356,6 +528,24 @@ bool SerialDevice::read(std::span<unsigned char> bytes)
     }
 }
 
+bool SerialDevice::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    unsigned long read = 0;
+    bytesRead = 0;
+
+    if (ReadFile(m_winHandle, bytes.data(), bytes.size(), &read, NULL))
+    {
+        bytesRead = read;
+        m_error = Error::NONE;
+        return true;
+    }
+    else
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+}
+
 bool SerialDevice::write(std::span<const unsigned char> bytes)
 {
     unsigned long written;
@@ -373,6 +563,46 @@ bool SerialDevice::write(std::span<const unsigned char> bytes)
     }
 }
 
+bool SerialDevice::setLine(const LineStep::Line& line, const bool& asserted)
+{
+    DWORD function;
+
+    if (line == LineStep::DTR)
+        function = asserted ? SETDTR : CLRDTR;
+    else
+        function = asserted ? SETRTS : CLRRTS;
+
+    return EscapeCommFunction(m_winHandle, function) != FALSE;
+}
+
+bool SerialDevice::flushInput()
+{
+    return PurgeComm(m_winHandle, PURGE_RXCLEAR) != FALSE;
+}
+
+std::chrono::microseconds SerialDevice::pendingTransmitTime()
+{
+    DWORD errors;
+    COMSTAT status;
+
+    if (m_winHandle == NULL || !ClearCommError(m_winHandle, &errors, &status))
+        return std::chrono::microseconds{0};
+
+    return transmitTime(status.cbOutQue);
+}
+
+bool SerialDevice::drain()
+{
+    if (!FlushFileBuffers(m_winHandle))
+    {
+        m_error = Error::DRAIN_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
 #elif __APPLE__
 
 bool SerialDevice::open()
@@ -517,8 +747,7 @@ bool SerialDevice::open()
 
     if (!ioctl(m_macFD, TIOCSETA, &tty))
     {
-        m_error = Error::NONE;
-        return true;
+        return reset();
     }
     else
     {
@@ -565,6 +794,31 @@ bool SerialDevice::read(std::span<unsigned char> bytes)
     }
 }
 
+bool SerialDevice::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+
+    if (m_macFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    ssize_t result = ::read(m_macFD, bytes.data(), bytes.size());
+
+    if (result != -1)
+    {
+        bytesRead = result;
+        m_error = Error::NONE;
+        return true;
+    }
+    else
+    {
+        m_error = Error::READ_FAILED;
+        return false;
+    }
+}
+
 bool SerialDevice::write(std::span<const unsigned char> bytes)
 {
     if (m_macFD == -1)
@@ -589,4 +843,43 @@ bool SerialDevice::write(std::span<const unsigned char> bytes)
     return false;
 }
 
+bool SerialDevice::setLine(const LineStep::Line& line, const bool& asserted)
+{
+    int bits = (line == LineStep::DTR) ? TIOCM_DTR : TIOCM_RTS;
+    return ioctl(m_macFD, asserted ? TIOCMBIS : TIOCMBIC, &bits) == 0;
+}
+
+bool SerialDevice::flushInput()
+{
+    return tcflush(m_macFD, TCIFLUSH) == 0;
+}
+
+std::chrono::microseconds SerialDevice::pendingTransmitTime()
+{
+    int queued = 0;
+
+    if (m_macFD == -1 || ioctl(m_macFD, TIOCOUTQ, &queued) != 0 || queued <= 0)
+        return std::chrono::microseconds{0};
+
+    return transmitTime(queued);
+}
+
+bool SerialDevice::drain()
+{
+    if (m_macFD == -1)
+    {
+        m_error = Error::DEVICE_NOT_OPEN;
+        return false;
+    }
+
+    if (tcdrain(m_macFD) != 0)
+    {
+        m_error = Error::DRAIN_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
+
 #endif
@@ -15,8 +15,7 @@
 #define SERIALDEVICE_H
 
 #include <filesystem>
-#include <iostream>
-#include <fstream>
+#include <string>
 #include <cstring>
 #include <errno.h>
 #include <chrono>
@@ -57,7 +56,9 @@ public:
         NOT_SUPPORTED,
         READ_FAILED,
         WRITE_FAILED,
-        DEVICE_NOT_OPEN
+        DEVICE_NOT_OPEN,
+        RESET_FAILED,
+        DRAIN_FAILED
     };
 
     struct DeviceProperties
@@ -71,6 +72,26 @@ public:
 
     constexpr static DeviceProperties ARIES{false, 1, false, 8, 115200};
 
+    // Drives one modem control line and holds it for holdTime milliseconds
+    struct LineStep
+    {
+        enum Line
+        {
+            DTR,
+            RTS
+        };
+
+        Line line;
+        bool asserted;
+        int32_t holdTime;
+    };
+
+    using ResetSequence = std::vector<LineStep>;
+
+    // Parses steps of the form line=level:holdTime separated by commas,
+    // e.g. "dtr=1:100,rts=1:100,dtr=0:50"
+    static bool parseResetSequence(const std::string& str, ResetSequence& sequence);
+
     SerialDevice(const std::filesystem::path& devicePath,
                  const DeviceProperties& deviceProperties,
                  const int32_t& readTimeout);
@@ -80,15 +101,32 @@ public:
 
     bool read(std::span<unsigned char> bytes);
     bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    // Bytes still in the transmit queue of the port, converted into the time
+    // they take on the wire at the configured baud rate and framing
+    std::chrono::microseconds pendingTransmitTime();
+    bool drain();
 
     bool open();
     bool close();
 
-private:
+    // Played after every successful open() to reset the target into its
+    // XMODEM receiver. Input received during the sequence is discarded.
+    void setResetSequence(const ResetSequence& sequence);
+    bool reset();
+
+#ifdef __linux
+    // Lets the port be waited on together with other file descriptors
+    const int32_t& linuxFD();
+#endif
+
+protected:
     Error m_error;
     const std::filesystem::path& m_devicePath;
     const DeviceProperties& m_deviceProperties;
     int32_t m_readTimeout;
+    ResetSequence m_resetSequence;
 
 #ifdef __linux
     int32_t m_linuxFD = -1;
@@ -98,9 +136,15 @@ private:
     int32_t m_macFD = -1;
 #endif
 
+private:
     bool openLinux();
     bool closeLinux();
 
+    bool setLine(const LineStep::Line& line, const bool& asserted);
+    bool flushInput();
+
+    std::chrono::microseconds transmitTime(const size_t& bytes);
+
 };
 
 #endif // SERIALDEVICE_H
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "sharedstatus.h"
+
+#include <thread>
+
+#ifndef __WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SharedStatus::SharedStatus()
+    : m_error{Error::NONE},
+      m_segment{nullptr},
+      m_fd{-1}
+{}
+
+SharedStatus::~SharedStatus()
+{
+    close();
+}
+
+const SharedStatus::Error &SharedStatus::error()
+{
+    return m_error;
+}
+
+std::string SharedStatus::errorStr()
+{
+    return errorStr(m_error);
+}
+
+std::string SharedStatus::errorStr(const Error &error)
+{
+    switch (error)
+    {
+    case NONE:
+        return "None";
+    case OPEN_FAILED:
+        return "Failed to open shared memory segment";
+    case MAPPING_FAILED:
+        return "Failed to map shared memory segment";
+    case INVALID_FORMAT:
+        return "Shared memory segment is not a vegadude status";
+    case NOT_SUPPORTED:
+        return "Shared status is not supported on this platform";
+    case UPDATE_STUCK:
+        return "Shared status is stuck in the middle of an update";
+    }
+
+    return "Unknown error " + std::to_string(error);
+}
+
+std::string SharedStatus::segmentName(const std::string &targetPath)
+{
+    std::string name = "/vegadude-";
+    size_t start = targetPath.find_first_not_of('/');
+
+    if (start == std::string::npos) return name;
+
+    for (char c : targetPath.substr(start))
+        name += (c == '/') ? '_' : c;
+
+    return name;
+}
+
+#ifdef __WIN32
+
+bool SharedStatus::open(const std::string&)
+{
+    m_error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+void SharedStatus::close()
+{}
+
+void SharedStatus::publish(const XModemSender::State&,
+                           const XModem::Error&,
+                           const size_t&,
+                           const size_t&,
+                           const int32_t&,
+                           const size_t&)
+{}
+
+bool SharedStatus::read(const std::string&, Snapshot&, Error& error)
+{
+    error = Error::NOT_SUPPORTED;
+    return false;
+}
+
+#else
+
+bool SharedStatus::open(const std::string &targetPath)
+{
+    close();
+
+    m_fd = shm_open(segmentName(targetPath).c_str(), O_CREAT | O_RDWR, 0644);
+
+    if (m_fd == -1)
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    void* address = MAP_FAILED;
+
+    if (ftruncate(m_fd, sizeof(Segment)) == 0)
+        address = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+
+    if (address == MAP_FAILED)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        m_error = Error::MAPPING_FAILED;
+        return false;
+    }
+
+    m_segment = static_cast<Segment*>(address);
+    m_start = std::chrono::steady_clock::now();
+
+    // Readers of a segment left by an earlier transfer must not see it half reset
+    uint32_t sequence = m_segment->sequence.load(std::memory_order_relaxed) | 1;
+    m_segment->sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_segment->magic = Magic;
+    m_segment->version = Version;
+    m_segment->pid.store(getpid(), std::memory_order_relaxed);
+    m_segment->sequence.store(sequence + 1, std::memory_order_release);
+
+    publish(XModemSender::State::HANDSHAKE, XModem::Error::NONE, 0, 0, 0, 0);
+
+    m_error = Error::NONE;
+    return true;
+}
+
+void SharedStatus::close()
+{
+    if (m_segment != nullptr)
+    {
+        munmap(m_segment, sizeof(Segment));
+        m_segment = nullptr;
+    }
+
+    if (m_fd != -1)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void SharedStatus::publish(const XModemSender::State &state,
+                           const XModem::Error &error,
+                           const size_t &block,
+                           const size_t &noOfBlocks,
+                           const int32_t &retries,
+                           const size_t &bytesSent)
+{
+    if (m_segment == nullptr) return;
+
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - m_start).count();
+    uint64_t updated = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+
+    uint32_t sequence = m_segment->sequence.load(std::memory_order_relaxed);
+    m_segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_segment->state.store(state, std::memory_order_relaxed);
+    m_segment->error.store(error, std::memory_order_relaxed);
+    m_segment->block.store(block, std::memory_order_relaxed);
+    m_segment->noOfBlocks.store(noOfBlocks, std::memory_order_relaxed);
+    m_segment->retries.store(retries, std::memory_order_relaxed);
+    m_segment->bytesSent.store(bytesSent, std::memory_order_relaxed);
+    m_segment->bytesPerSecond.store(elapsed == 0 ? 0 : bytesSent * 1000000 / elapsed,
+                                    std::memory_order_relaxed);
+    m_segment->updated.store(updated, std::memory_order_relaxed);
+
+    m_segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool SharedStatus::read(const std::string &targetPath, Snapshot &snapshot, Error &error)
+{
+    int fd = shm_open(segmentName(targetPath).c_str(), O_RDONLY, 0);
+
+    if (fd == -1)
+    {
+        error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    struct stat st;
+    void* address = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(Segment)))
+        address = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if (address == MAP_FAILED)
+    {
+        error = Error::MAPPING_FAILED;
+        return false;
+    }
+
+    const Segment* segment = static_cast<const Segment*>(address);
+
+    if (segment->magic != Magic || segment->version != Version)
+    {
+        munmap(address, sizeof(Segment));
+        error = Error::INVALID_FORMAT;
+        return false;
+    }
+
+    uint32_t before, after;
+
+    // Spins first, as updates take nanoseconds, then backs off until ReadTimeout
+    constexpr int32_t spins = 100;
+    auto deadline = std::chrono::steady_clock::now() + ReadTimeout;
+
+    for (int32_t attempt = 0; ; attempt++)
+    {
+        before = segment->sequence.load(std::memory_order_acquire);
+
+        snapshot.pid = segment->pid.load(std::memory_order_relaxed);
+        snapshot.state = static_cast<XModemSender::State>(segment->state.load(std::memory_order_relaxed));
+        snapshot.error = static_cast<XModem::Error>(segment->error.load(std::memory_order_relaxed));
+        snapshot.block = segment->block.load(std::memory_order_relaxed);
+        snapshot.noOfBlocks = segment->noOfBlocks.load(std::memory_order_relaxed);
+        snapshot.retries = segment->retries.load(std::memory_order_relaxed);
+        snapshot.bytesSent = segment->bytesSent.load(std::memory_order_relaxed);
+        snapshot.bytesPerSecond = segment->bytesPerSecond.load(std::memory_order_relaxed);
+        snapshot.updated = segment->updated.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = segment->sequence.load(std::memory_order_relaxed);
+
+        if (!(before & 1) && before == after) break;
+
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            munmap(address, sizeof(Segment));
+            error = Error::UPDATE_STUCK;
+            return false;
+        }
+
+        if (attempt < spins)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+
+    munmap(address, sizeof(Segment));
+
+    error = Error::NONE;
+    return true;
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef SHAREDSTATUS_H
+#define SHAREDSTATUS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "xmodemsender.h"
+
+// Live status of a transfer in a POSIX shared memory segment named after the
+// target, so monitors can follow many uploads without parsing their output.
+//
+// The segment is written by a single transfer without locks, as a seqlock:
+// sequence is odd while an update is in progress. Readers copy the fields,
+// and retry if sequence was odd or changed in the meantime, giving up after
+// ReadTimeout in case the writer died in the middle of an update. The segment is
+// left in place after the transfer, holding its final state.
+class SharedStatus
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        OPEN_FAILED,
+        MAPPING_FAILED,
+        INVALID_FORMAT,
+        NOT_SUPPORTED,
+        UPDATE_STUCK
+    };
+
+    // Layout of the segment, fixed for monitors written in other languages.
+    // All fields are little endian on the platforms vegadude runs on.
+    struct Segment
+    {
+        uint32_t magic;
+        uint32_t version;
+        std::atomic<uint32_t> sequence;
+        std::atomic<int32_t> pid;
+        std::atomic<uint32_t> state;            // XModemSender::State
+        std::atomic<uint32_t> error;            // XModem::Error
+        std::atomic<uint64_t> block;
+        std::atomic<uint64_t> noOfBlocks;
+        std::atomic<uint64_t> retries;
+        std::atomic<uint64_t> bytesSent;
+        std::atomic<uint64_t> bytesPerSecond;
+        std::atomic<uint64_t> updated;          // nanoseconds since the UNIX epoch
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+    static_assert(sizeof(Segment) == 72);
+
+    // A consistent copy of the segment
+    struct Snapshot
+    {
+        int32_t pid;
+        XModemSender::State state;
+        XModem::Error error;
+        uint64_t block;
+        uint64_t noOfBlocks;
+        uint64_t retries;
+        uint64_t bytesSent;
+        uint64_t bytesPerSecond;
+        uint64_t updated;
+    };
+
+    constexpr static uint32_t Magic {0x54534456};   // "VDST"
+    constexpr static uint32_t Version {1};
+    constexpr static std::chrono::milliseconds ReadTimeout {100};
+
+    SharedStatus();
+    ~SharedStatus();
+
+    SharedStatus(const SharedStatus&) = delete;
+    SharedStatus& operator=(const SharedStatus&) = delete;
+
+    const Error& error();
+    std::string errorStr();
+    static std::string errorStr(const Error& error);
+
+    // Name of the segment for targetPath, e.g. /vegadude-dev_ttyUSB0
+    static std::string segmentName(const std::string& targetPath);
+
+    // Creates the segment, or takes over the one left by an earlier transfer
+    bool open(const std::string& targetPath);
+    void close();
+
+    void publish(const XModemSender::State& state,
+                 const XModem::Error& error,
+                 const size_t& block,
+                 const size_t& noOfBlocks,
+                 const int32_t& retries,
+                 const size_t& bytesSent);
+
+    static bool read(const std::string& targetPath, Snapshot& snapshot, Error& error);
+
+private:
+    Error m_error;
+    Segment* m_segment;
+    int32_t m_fd;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif // SHAREDSTATUS_H
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "simulateddevice.h"
+#include "crc.h"
+#include "xmodem.h"
+
+#include <algorithm>
+
+SimulatedDevice::SimulatedDevice(const int32_t& blockSize,
+                                 const int32_t& baudRate,
+                                 const int32_t& readTimeout)
+    : m_blockSize{blockSize},
+      // Start bit, 8 data bits and a stop bit
+      m_byteTime{10000000ULL / static_cast<uint64_t>(baudRate)},
+      m_readTimeout{static_cast<uint64_t>(readTimeout) * 1000},
+      m_timeLimit{0}
+{
+    reset();
+}
+
+void SimulatedDevice::reset()
+{
+    m_packet.clear();
+    m_output.clear();
+    m_received.clear();
+
+    m_expectedBlock = 0;
+    m_started = false;
+    m_complete = false;
+    m_cancelled = false;
+    m_idleReads = 0;
+
+    m_elapsed = 0;
+    m_rejected = 0;
+    m_timeouts = 0;
+
+    respond(XModem::C);
+}
+
+void SimulatedDevice::setTimeLimit(const uint64_t& limit)
+{
+    m_timeLimit = limit;
+}
+
+void SimulatedDevice::respond(const unsigned char& byte)
+{
+    m_output.push_back(byte);
+}
+
+void SimulatedDevice::receive(const unsigned char& byte)
+{
+    if (m_cancelled) return;
+
+    // The ACK for EOT may have been lost, acknowledge it again
+    if (m_complete)
+    {
+        if (byte == XModem::EOT) respond(XModem::ACK);
+        return;
+    }
+
+    if (m_packet.empty())
+    {
+        if (byte == XModem::EOT)
+        {
+            m_complete = true;
+            respond(XModem::ACK);
+        }
+        else if (byte == XModem::CAN)
+        {
+            m_cancelled = true;
+        }
+        else if (byte == XModem::SOH)
+        {
+            m_packet.push_back(byte);
+        }
+
+        // Anything else is line noise between packets
+        return;
+    }
+
+    m_packet.push_back(byte);
+
+    if (m_packet.size() < static_cast<size_t>(3 + m_blockSize + 2)) return;
+
+    std::span<const unsigned char> data{m_packet.data() + 3, static_cast<size_t>(m_blockSize)};
+    uint16_t crc = (m_packet[3 + m_blockSize] << 8) | m_packet[4 + m_blockSize];
+
+    if (m_packet[1] != 255 - m_packet[2] || crc != CRC::generateCRC16CCITT(data))
+    {
+        m_rejected++;
+        respond(XModem::NAK);
+    }
+    else if (m_packet[1] == m_expectedBlock)
+    {
+        m_received.insert(m_received.end(), data.begin(), data.end());
+        m_expectedBlock++;
+        m_started = true;
+        respond(XModem::ACK);
+    }
+    else if (m_started && m_packet[1] == static_cast<unsigned char>(m_expectedBlock - 1))
+    {
+        // Our ACK got lost, the sender repeated the last block
+        respond(XModem::ACK);
+    }
+    else
+    {
+        // Out of sequence, the transfer can not be recovered
+        m_rejected++;
+        m_cancelled = true;
+        respond(XModem::CAN);
+        respond(XModem::CAN);
+    }
+
+    m_packet.clear();
+}
+
+bool SimulatedDevice::read(std::span<unsigned char> bytes)
+{
+    size_t bytesRead;
+    return readSome(bytes, bytesRead);
+}
+
+bool SimulatedDevice::readSome(std::span<unsigned char> bytes, size_t& bytesRead)
+{
+    bytesRead = 0;
+    if (m_timeLimit != 0 && m_elapsed > m_timeLimit) return false;
+
+    bytesRead = std::min(bytes.size(), m_output.size());
+
+    if (bytesRead == 0)
+    {
+        m_elapsed += m_readTimeout;
+        m_timeouts++;
+
+        // The sender went quiet, ask again like a real receiver would
+        if (++m_idleReads >= IdleReadsBeforeNak && !m_complete)
+        {
+            m_idleReads = 0;
+            m_packet.clear();
+
+            if (m_cancelled)
+                respond(XModem::CAN);
+            else
+                respond(m_started ? XModem::NAK : XModem::C);
+        }
+
+        return true;
+    }
+
+    std::copy_n(m_output.begin(), bytesRead, bytes.begin());
+    m_output.erase(m_output.begin(), m_output.begin() + bytesRead);
+    m_elapsed += bytesRead * m_byteTime;
+
+    return true;
+}
+
+bool SimulatedDevice::write(std::span<const unsigned char> bytes)
+{
+    m_idleReads = 0;
+    m_elapsed += bytes.size() * m_byteTime;
+
+    for (auto&& byte : bytes)
+        receive(byte);
+
+    return true;
+}
+
+bool SimulatedDevice::complete()
+{
+    return m_complete;
+}
+
+bool SimulatedDevice::cancelled()
+{
+    return m_cancelled;
+}
+
+const std::vector<unsigned char> &SimulatedDevice::received()
+{
+    return m_received;
+}
+
+const uint64_t &SimulatedDevice::elapsed()
+{
+    return m_elapsed;
+}
+
+const size_t &SimulatedDevice::rejected()
+{
+    return m_rejected;
+}
+
+const size_t &SimulatedDevice::timeouts()
+{
+    return m_timeouts;
+}
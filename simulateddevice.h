@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef SIMULATEDDEVICE_H
+#define SIMULATEDDEVICE_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "device.h"
+
+// In-memory board running an XMODEM-CRC receiver, for benchmarks.
+// Nothing is slept, instead time spent on the simulated wire and in read
+// timeouts is accumulated in elapsed().
+class SimulatedDevice : public Device
+{
+public:
+
+    SimulatedDevice(const int32_t& blockSize,
+                    const int32_t& baudRate,
+                    const int32_t& readTimeout);
+
+    bool read(std::span<unsigned char> bytes);
+    bool write(std::span<const unsigned char> bytes);
+    bool readSome(std::span<unsigned char> bytes, size_t& bytesRead);
+
+    // Forgets everything received and asks for the first block again
+    void reset();
+
+    // Reads fail once elapsed() passes limit, so a stuck sender
+    // gives up instead of waiting forever. 0 disables the limit.
+    void setTimeLimit(const uint64_t& limit);
+
+    bool complete();
+    bool cancelled();
+    const std::vector<unsigned char>& received();
+
+    // Microseconds
+    const uint64_t& elapsed();
+
+    // Number of packets received with a bad CRC, block number or length
+    const size_t& rejected();
+
+    // Host reads that found nothing to read, each costs one read timeout
+    const size_t& timeouts();
+
+private:
+    int32_t m_blockSize;
+    uint64_t m_byteTime;
+    uint64_t m_readTimeout;
+
+    std::vector<unsigned char> m_packet;
+    std::deque<unsigned char> m_output;
+    std::vector<unsigned char> m_received;
+
+    unsigned char m_expectedBlock;
+    bool m_started;
+    bool m_complete;
+    bool m_cancelled;
+    int32_t m_idleReads;
+
+    uint64_t m_elapsed;
+    uint64_t m_timeLimit;
+    size_t m_rejected;
+    size_t m_timeouts;
+
+    void receive(const unsigned char& byte);
+    void respond(const unsigned char& byte);
+
+    constexpr static int32_t IdleReadsBeforeNak {2};
+};
+
+#endif // SIMULATEDDEVICE_H
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "soak.h"
+#include "logger.h"
+
+#include <cstdio>
+
+void Soak::add(const Run &run)
+{
+    m_runs.push_back(run);
+}
+
+const std::vector<Soak::Run> &Soak::runs()
+{
+    return m_runs;
+}
+
+template<typename F>
+Soak::Statistics Soak::statistics(const size_t& first, F value)
+{
+    Statistics result;
+
+    if (m_runs.size() <= first) return result;
+
+    double n = m_runs.size() - first;
+
+    for (size_t i = first; i < m_runs.size(); i++)
+        result.mean += value(m_runs[i]);
+
+    result.mean /= n;
+
+    // Runs are numbered from their position in the soak, so the slope is
+    // per run whichever one the fit starts at
+    double meanRun = (first + m_runs.size() - 1) / 2.0;
+    double covariance = 0;
+    double runVariance = 0;
+
+    for (size_t i = first; i < m_runs.size(); i++)
+    {
+        double deviation = value(m_runs[i]) - result.mean;
+
+        result.variance += deviation * deviation;
+        covariance += (i - meanRun) * deviation;
+        runVariance += (i - meanRun) * (i - meanRun);
+    }
+
+    if (n > 1) result.variance /= n - 1;
+    if (runVariance > 0) result.trend = covariance / runVariance;
+
+    return result;
+}
+
+bool Soak::throughputDegraded()
+{
+    if (m_runs.size() < 3) return false;
+
+    Statistics throughput = statistics(0, [](const Run& run) { return run.throughput; });
+
+    return -throughput.trend * (m_runs.size() - 1) > MaxThroughputDrop * throughput.mean;
+}
+
+bool Soak::memoryGrowing()
+{
+    if (m_runs.size() < 4 || m_runs.front().residentSetSize == 0) return false;
+
+    Statistics memory = statistics(1, [](const Run& run) { return double(run.residentSetSize); });
+
+    return memory.trend * (m_runs.size() - 2) > MaxMemoryGrowth;
+}
+
+bool Soak::report()
+{
+    Logger::get() << "Run  Throughput (B/s)  Handshake (ms)  Retries  RSS (KiB)" << Logger::NewLine;
+
+    for (size_t i = 0; i < m_runs.size(); i++)
+    {
+        char line[96];
+        std::snprintf(line, sizeof(line), "%3zu  %16.0f  %14.1f  %7d  %9zu",
+                      i + 1, m_runs[i].throughput, m_runs[i].handshakeTime,
+                      m_runs[i].retries, m_runs[i].residentSetSize / 1024);
+
+        Logger::get() << static_cast<const char*>(line) << Logger::NewLine;
+    }
+
+    auto print = [&](const char* name, const size_t& first, auto value) {
+        Statistics result = statistics(first, value);
+
+        char line[112];
+        std::snprintf(line, sizeof(line), "%-22s mean %.6g, variance %.6g, trend %+.6g per run",
+                      name, result.mean, result.variance, result.trend);
+
+        Logger::get() << static_cast<const char*>(line) << Logger::NewLine;
+    };
+
+    Logger::get() << Logger::NewLine << m_runs.size() << " uploads:" << Logger::NewLine;
+
+    print("Throughput (B/s)", 0, [](const Run& run) { return run.throughput; });
+    print("Handshake (ms)", 0, [](const Run& run) { return run.handshakeTime; });
+    print("Retries", 0, [](const Run& run) { return double(run.retries); });
+
+    if (!m_runs.empty() && m_runs.front().residentSetSize != 0)
+        print("RSS after run 1 (KiB)", 1, [](const Run& run) { return run.residentSetSize / 1024.0; });
+
+    bool healthy = true;
+
+    if (throughputDegraded())
+    {
+        Logger::get() << "Warning: throughput fell by more than " << MaxThroughputDrop * 100
+                      << "% over the soak." << Logger::NewLine;
+        healthy = false;
+    }
+
+    if (memoryGrowing())
+    {
+        Logger::get() << "Warning: resident set grew by more than " << MaxMemoryGrowth / 1024
+                      << " KiB after the first run." << Logger::NewLine;
+        healthy = false;
+    }
+
+    return healthy;
+}
+
+size_t Soak::residentSetSize()
+{
+#ifdef __linux
+    // The second field of statm is the resident set size in pages
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) return 0;
+
+    size_t size = 0, resident = 0;
+    int fields = std::fscanf(statm, "%zu %zu", &size, &resident);
+    std::fclose(statm);
+
+    if (fields != 2) return 0;
+
+    return resident * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#ifdef __linux
+#include <unistd.h>
+#endif
+
+// Collects the outcome of repeated uploads to the same target and tells
+// whether they slow down, or the process grows, as the runs go on
+class Soak
+{
+public:
+
+    struct Run
+    {
+        double throughput;          // bytes per second once the handshake is over
+        double handshakeTime;       // milliseconds
+        int32_t retries;
+        size_t residentSetSize;     // bytes, 0 where it cannot be read
+    };
+
+    // Mean, variance and the slope of the least squares line through the
+    // values, in units per run
+    struct Statistics
+    {
+        double mean = 0;
+        double variance = 0;
+        double trend = 0;
+    };
+
+    // The fitted throughput may fall by this fraction of its mean over the
+    // whole soak, the resident set size may grow by MaxMemoryGrowth bytes
+    constexpr static double MaxThroughputDrop {0.05};
+    constexpr static size_t MaxMemoryGrowth {64 * 1024};
+
+    void add(const Run& run);
+    const std::vector<Run>& runs();
+
+    bool throughputDegraded();
+    // The first run is left out, it pays for everything allocated once
+    bool memoryGrowing();
+
+    // Prints every run, the statistics and what was flagged. Returns false
+    // if anything was.
+    bool report();
+
+    // Of the calling process, 0 where it cannot be read
+    static size_t residentSetSize();
+
+private:
+    std::vector<Run> m_runs;
+
+    template<typename F>
+    Statistics statistics(const size_t& first, F value);
+};
+
+#endif // SOAK_H
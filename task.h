@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+// Lazily started coroutine returning a T.
+// Awaiting it starts it and resumes the awaiter once it has finished.
+template<typename T>
+class Task
+{
+public:
+
+    struct promise_type
+    {
+        T value {};
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object()
+        {
+            return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+            {
+                if (handle.promise().continuation)
+                    return handle.promise().continuation;
+
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_value(T result)
+        {
+            value = std::move(result);
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    Task(Task&& other) noexcept
+        : m_handle{std::exchange(other.m_handle, nullptr)}
+    {}
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (m_handle) m_handle.destroy();
+    }
+
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        m_handle.promise().continuation = awaiter;
+        return m_handle;
+    }
+
+    T await_resume()
+    {
+        return std::move(m_handle.promise().value);
+    }
+
+    // Used to start a task that nothing awaits
+    void start()
+    {
+        m_handle.resume();
+    }
+
+    bool done()
+    {
+        return m_handle.done();
+    }
+
+    T& result()
+    {
+        return m_handle.promise().value;
+    }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : m_handle{handle}
+    {}
+};
+
+#endif // TASK_H
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "vegadude.h"
+
+#include "serialdevice.h"
+#include "buffereddevice.h"
+#include "xmodem.h"
+
+#include <new>
+
+struct vegadude_device
+{
+    std::filesystem::path targetPath;
+    SerialDevice::DeviceProperties properties;
+
+    SerialDevice serialDevice;
+    BufferedDevice bufferedDevice;
+    XModem modem;
+
+    bool open;
+    std::string error;
+
+    vegadude_device(const vegadude_config& config)
+        : targetPath{config.target_path},
+          properties{config.parity != 0, config.stop_bits, config.rts_cts != 0, config.bits, config.baud_rate},
+          serialDevice{targetPath, properties, config.read_timeout},
+          bufferedDevice{serialDevice},
+          modem{bufferedDevice, config.xmodem_max_retry, config.xmodem_block_size},
+          open{false}
+    {}
+};
+
+namespace
+{
+
+bool validConfig(const vegadude_config* config)
+{
+    // Later versions accept the sizes of earlier ones and default the fields they lack
+    return config != nullptr &&
+            config->size == sizeof(vegadude_config) &&
+            config->target_path != nullptr && config->target_path[0] != '\0' &&
+            (config->stop_bits == 1 || config->stop_bits == 2) &&
+            config->bits >= 5 && config->bits <= 8 &&
+            config->baud_rate > 0 &&
+            config->read_timeout >= 0 &&
+            config->xmodem_max_retry >= 0 &&
+            config->xmodem_block_size > 0;
+}
+
+vegadude_device* createDevice(const vegadude_config& config)
+{
+#ifdef VEGADUDE_MINIMAL
+    return new (std::nothrow) vegadude_device{config};
+#else
+    try
+    {
+        return new vegadude_device{config};
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+#endif
+}
+
+int transferResult(vegadude_device* device, const bool& result)
+{
+    if (result) return VEGADUDE_OK;
+
+    device->error = (device->modem.error() == XModem::Error::DEVICE_RELATED) ?
+                device->serialDevice.errorStr() : device->modem.errorStr();
+    return VEGADUDE_FAILED;
+}
+
+}
+
+void vegadude_config_aries(vegadude_config* config, const char* target_path)
+{
+    if (config == nullptr) return;
+
+    config->size = sizeof(vegadude_config);
+    config->target_path = target_path;
+    config->parity = SerialDevice::ARIES.parity;
+    config->stop_bits = SerialDevice::ARIES.stopBits;
+    config->rts_cts = SerialDevice::ARIES.rtsCts;
+    config->bits = SerialDevice::ARIES.bits;
+    config->baud_rate = SerialDevice::ARIES.baudRate;
+    config->read_timeout = 500;
+    config->xmodem_max_retry = 10;
+    config->xmodem_block_size = ARIES_XMODEM_BLOCK_SIZE;
+}
+
+vegadude_device* vegadude_create(const vegadude_config* config, vegadude_create_error* error)
+{
+    vegadude_create_error result = VEGADUDE_CREATE_OK;
+    vegadude_device* device = nullptr;
+
+    if (!validConfig(config))
+        result = VEGADUDE_CREATE_INVALID_CONFIG;
+    else if ((device = createDevice(*config)) == nullptr)
+        result = VEGADUDE_CREATE_OUT_OF_MEMORY;
+
+    if (error != nullptr)
+        *error = result;
+
+    return device;
+}
+
+void vegadude_destroy(vegadude_device* device)
+{
+    if (device == nullptr) return;
+
+    if (device->open)
+        vegadude_close(device);
+
+    delete device;
+}
+
+int vegadude_open(vegadude_device* device)
+{
+    if (device == nullptr) return VEGADUDE_INVALID_ARGUMENT;
+
+    if (!device->serialDevice.open())
+    {
+        device->error = device->serialDevice.errorStr();
+        return VEGADUDE_FAILED;
+    }
+
+    device->open = true;
+    return VEGADUDE_OK;
+}
+
+int vegadude_close(vegadude_device* device)
+{
+    if (device == nullptr) return VEGADUDE_INVALID_ARGUMENT;
+
+    device->open = false;
+
+    if (!device->serialDevice.close())
+    {
+        device->error = device->serialDevice.errorStr();
+        return VEGADUDE_FAILED;
+    }
+
+    return VEGADUDE_OK;
+}
+
+int vegadude_upload_file(vegadude_device* device, const char* file_path, int start_after_upload)
+{
+    if (device == nullptr || file_path == nullptr) return VEGADUDE_INVALID_ARGUMENT;
+
+    return transferResult(device, device->modem.upload(std::filesystem::path{file_path},
+                                                     start_after_upload != 0));
+}
+
+int vegadude_upload_buffer(vegadude_device* device, const unsigned char* data, size_t size, int start_after_upload)
+{
+    if (device == nullptr || (data == nullptr && size > 0)) return VEGADUDE_INVALID_ARGUMENT;
+
+    return transferResult(device, device->modem.upload(std::span<const unsigned char>{data, size},
+                                                     start_after_upload != 0));
+}
+
+int vegadude_download_file(vegadude_device* device, const char* file_path, int strip_padding)
+{
+    if (device == nullptr || file_path == nullptr) return VEGADUDE_INVALID_ARGUMENT;
+
+    return transferResult(device, device->modem.download(std::filesystem::path{file_path},
+                                                       strip_padding != 0));
+}
+
+void vegadude_set_progress_callback(vegadude_device* device,
+                                    vegadude_progress_callback callback,
+                                    void* user_data)
+{
+    if (device == nullptr) return;
+
+    if (callback == nullptr)
+    {
+        device->modem.setProgressCallback(nullptr);
+        return;
+    }
+
+    device->modem.setProgressCallback([callback, user_data](const size_t& block, const size_t& noOfBlocks) {
+        callback(block, noOfBlocks, user_data);
+    });
+}
+
+void vegadude_cancel(vegadude_device* device)
+{
+    if (device == nullptr) return;
+
+    device->modem.cancel();
+}
+
+const char* vegadude_error(vegadude_device* device)
+{
+    if (device == nullptr) return "Invalid device";
+
+    return device->error.c_str();
+}
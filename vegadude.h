@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef VEGADUDE_H
+#define VEGADUDE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#define VEGADUDE_API
+#else
+#define VEGADUDE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vegadude_device vegadude_device;
+
+/* size must be set to sizeof(vegadude_config), so fields can be added
+   later without breaking callers built against this version */
+typedef struct vegadude_config
+{
+    size_t size;
+
+    const char* target_path;
+
+    int parity;
+    int32_t stop_bits;
+    int rts_cts;
+    int32_t bits;
+    int32_t baud_rate;
+    int32_t read_timeout;
+
+    int32_t xmodem_max_retry;
+    int32_t xmodem_block_size;
+} vegadude_config;
+
+typedef enum vegadude_create_error
+{
+    VEGADUDE_CREATE_OK = 0,
+    VEGADUDE_CREATE_INVALID_CONFIG,
+    VEGADUDE_CREATE_OUT_OF_MEMORY
+} vegadude_create_error;
+
+typedef enum vegadude_result
+{
+    VEGADUDE_OK = 0,
+    VEGADUDE_FAILED = -1,
+    /* A NULL device, path or buffer was passed */
+    VEGADUDE_INVALID_ARGUMENT = -2
+} vegadude_result;
+
+typedef void (*vegadude_progress_callback)(size_t block, size_t no_of_blocks, void* user_data);
+
+/* Fills config, including size, with the CDAC Aries settings and default timeouts */
+VEGADUDE_API void vegadude_config_aries(vegadude_config* config, const char* target_path);
+
+/* Returns NULL if config is invalid or memory runs out, and stores the reason
+   in error unless it is NULL. Nothing is opened yet. */
+VEGADUDE_API vegadude_device* vegadude_create(const vegadude_config* config, vegadude_create_error* error);
+VEGADUDE_API void vegadude_destroy(vegadude_device* device);
+
+/* All functions returning int return a vegadude_result. On VEGADUDE_FAILED
+   vegadude_error describes what went wrong. Functions returning nothing
+   ignore a NULL device. */
+VEGADUDE_API int vegadude_open(vegadude_device* device);
+VEGADUDE_API int vegadude_close(vegadude_device* device);
+
+VEGADUDE_API int vegadude_upload_file(vegadude_device* device, const char* file_path, int start_after_upload);
+VEGADUDE_API int vegadude_upload_buffer(vegadude_device* device, const unsigned char* data, size_t size, int start_after_upload);
+/* Receives a file sent by the target. SUB padding at the end is removed
+   if strip_padding is non zero. */
+VEGADUDE_API int vegadude_download_file(vegadude_device* device, const char* file_path, int strip_padding);
+
+/* Replaces the progress bar printed to stderr. Pass NULL to restore it. */
+VEGADUDE_API void vegadude_set_progress_callback(vegadude_device* device,
+                                                 vegadude_progress_callback callback,
+                                                 void* user_data);
+
+/* Aborts the running transfer, or the next one if none is running.
+   May be called from any thread or from the progress callback */
+VEGADUDE_API void vegadude_cancel(vegadude_device* device);
+
+/* Valid until the next call on device, a fixed message if device is NULL */
+VEGADUDE_API const char* vegadude_error(vegadude_device* device);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VEGADUDE_H
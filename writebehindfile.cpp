@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "writebehindfile.h"
+
+WriteBehindFile::WriteBehindFile()
+    : m_error{Error::NONE},
+      m_closing{false},
+      m_failed{false}
+{}
+
+WriteBehindFile::~WriteBehindFile()
+{
+    close();
+}
+
+const WriteBehindFile::Error &WriteBehindFile::error()
+{
+    return m_error;
+}
+
+std::string WriteBehindFile::errorStr()
+{
+    switch (m_error)
+    {
+    case NONE:
+        return "None";
+    case OPEN_FAILED:
+        return "Failed to open file";
+    case WRITE_FAILED:
+        return "Failed to write file";
+    }
+
+    return "Unknown error " + std::to_string(m_error);
+}
+
+bool WriteBehindFile::open(const std::filesystem::path &filePath)
+{
+    m_stream.open(filePath, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+
+    if (m_stream.fail())
+    {
+        m_error = Error::OPEN_FAILED;
+        return false;
+    }
+
+    m_closing = false;
+    m_failed = false;
+    m_current.reserve(ChunkSize);
+    m_thread = std::thread{&WriteBehindFile::run, this};
+
+    m_error = Error::NONE;
+    return true;
+}
+
+bool WriteBehindFile::write(std::span<const unsigned char> bytes)
+{
+    if (m_failed)
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    m_current.insert(m_current.end(), bytes.begin(), bytes.end());
+
+    if (m_current.size() >= ChunkSize) submit();
+
+    m_error = Error::NONE;
+    return true;
+}
+
+void WriteBehindFile::submit()
+{
+    std::unique_lock lock{m_mutex};
+
+    m_written.wait(lock, [this] { return m_queue.size() < MaxQueued || m_failed; });
+
+    m_queue.push_back(std::move(m_current));
+
+    if (m_spare.empty())
+    {
+        m_current = {};
+        m_current.reserve(ChunkSize);
+    }
+    else
+    {
+        m_current = std::move(m_spare.back());
+        m_spare.pop_back();
+    }
+
+    lock.unlock();
+    m_queued.notify_one();
+}
+
+void WriteBehindFile::run()
+{
+    std::unique_lock lock{m_mutex};
+
+    while (true)
+    {
+        m_queued.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+
+        if (m_queue.empty()) break;
+
+        std::vector<unsigned char> chunk = std::move(m_queue.front());
+        m_queue.pop_front();
+
+        lock.unlock();
+
+        if (!m_failed)
+        {
+            m_stream.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+            if (m_stream.fail()) m_failed = true;
+        }
+
+        chunk.clear();
+
+        lock.lock();
+        m_spare.push_back(std::move(chunk));
+        m_written.notify_one();
+    }
+}
+
+bool WriteBehindFile::close()
+{
+    if (!m_thread.joinable())
+    {
+        m_error = m_failed ? Error::WRITE_FAILED : Error::NONE;
+        return !m_failed;
+    }
+
+    if (!m_current.empty()) submit();
+
+    {
+        std::lock_guard lock{m_mutex};
+        m_closing = true;
+    }
+
+    m_queued.notify_one();
+    m_thread.join();
+
+    m_stream.close();
+
+    if (m_failed || m_stream.fail())
+    {
+        m_error = Error::WRITE_FAILED;
+        return false;
+    }
+
+    m_error = Error::NONE;
+    return true;
+}
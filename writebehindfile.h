@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef WRITEBEHINDFILE_H
+#define WRITEBEHINDFILE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Output file written by a background thread. write() only copies into
+// memory, so a slow disk does not hold up the caller. Only if more than
+// MaxQueued chunks are waiting does write() block.
+class WriteBehindFile
+{
+public:
+
+    enum Error
+    {
+        NONE,
+        OPEN_FAILED,
+        WRITE_FAILED
+    };
+
+    constexpr static size_t ChunkSize {64 * 1024};
+    constexpr static size_t MaxQueued {256};
+
+    WriteBehindFile();
+    ~WriteBehindFile();
+
+    const Error& error();
+    std::string errorStr();
+
+    bool open(const std::filesystem::path& filePath);
+    // Fails once the background thread could not write
+    bool write(std::span<const unsigned char> bytes);
+    // Waits for everything to reach the file
+    bool close();
+
+private:
+    Error m_error;
+    std::ofstream m_stream;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_queued;
+    std::condition_variable m_written;
+    std::deque<std::vector<unsigned char>> m_queue;
+    std::vector<std::vector<unsigned char>> m_spare;
+    bool m_closing;
+    std::atomic<bool> m_failed;
+
+    std::vector<unsigned char> m_current;
+
+    void submit();
+    void run();
+};
+
+#endif // WRITEBEHINDFILE_H
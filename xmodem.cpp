@@ -12,20 +12,48 @@
  */
 
 #include "xmodem.h"
+#include "xmodemsender.h"
+#include "writebehindfile.h"
+#include "sharedstatus.h"
 #include "crc.h"
 
-#include <fstream>
-#include <istream>
-#include <iostream>
-#include <cmath>
-
 #include "logger.h"
+#include "binarylogger.h"
+
+#include <charconv>
+#include <cstdio>
+
+namespace
+{
+const uint16_t LogReceived = BinaryLogger::registerFormat("download: block {} received, {} bytes");
+const uint16_t LogDuplicate = BinaryLogger::registerFormat("download: block {} received again");
+const uint16_t LogRejected = BinaryLogger::registerFormat("download: rejected block, {}");
+const uint16_t LogFinished = BinaryLogger::registerFormat("download: finished, {} blocks, {} retries");
+
+uint16_t blockCRC(std::span<const unsigned char> block)
+{
+    switch (block.size())
+    {
+    case XModemSender::FixedBlockSizes[0]:
+        return CRC::generateCRC16CCITT(block.first<XModemSender::FixedBlockSizes[0]>());
+    case XModemSender::FixedBlockSizes[1]:
+        return CRC::generateCRC16CCITT(block.first<XModemSender::FixedBlockSizes[1]>());
+    default:
+        return CRC::generateCRC16CCITT(block);
+    }
+}
+}
 
 XModem::XModem(Device& device, const int32_t& maxRetry, const int32_t &blockSize)
     : m_error{Error::NONE},
       m_device{device},
       m_maxRetry{maxRetry},
-      m_blockSize{blockSize}
+      m_blockSize{blockSize},
+      m_clock{steadyClock},
+      m_cancelled{false},
+      m_prefault{false},
+      m_drain{false},
+      m_sharedStatus{nullptr}
 {}
 
 const XModem::Error &XModem::error()
@@ -35,7 +63,12 @@ const XModem::Error &XModem::error()
 
 std::string XModem::errorStr()
 {
-    switch (m_error)
+    return errorStr(m_error);
+}
+
+std::string XModem::errorStr(const Error& error)
+{
+    switch (error)
     {
     case NONE:
         return "None";
@@ -49,130 +82,512 @@ std::string XModem::errorStr()
         return "Max retries surpassed";
     case CANCELLED:
         return "Operation cancelled";
+    case ABORTED:
+        return "Upload aborted";
+    case PACKET_FILE_INVALID:
+        return "Invalid packet file";
+    case BLOCK_SIZE_MISMATCH:
+        return "Packet file was made for a different block size";
+    case HANDSHAKE_TIMED_OUT:
+        return "Target did not respond to the handshake in time";
+    case OUT_OF_SEQUENCE:
+        return "Target sent a block out of sequence";
+    case FILE_WRITE_FAILED:
+        return "Failed to write file";
+    case ARCHIVE_INVALID:
+        return "Archive could not be read, or is not a tar or cpio archive";
+    case ARCHIVE_MEMBER_NOT_FOUND:
+        return "No such regular file in archive";
+    case PATCH_OUT_OF_RANGE:
+        return "Patch does not fit inside the image";
+    }
+
+    return "Unknown error " + std::to_string(error);
+}
+
+void XModem::setProgressCallback(const ProgressCallback& callback)
+{
+    m_progressCallback = callback;
+}
+
+void XModem::cancel()
+{
+    m_cancelled = true;
+}
+
+void XModem::setTimeouts(const Timeouts& timeouts)
+{
+    m_timeouts = timeouts;
+}
+
+void XModem::setPrefault(const bool &prefault)
+{
+    m_prefault = prefault;
+}
+
+void XModem::setDrain(const bool &drain)
+{
+    m_drain = drain;
+}
+
+void XModem::setSharedStatus(SharedStatus *status)
+{
+    m_sharedStatus = status;
+}
+
+const std::vector<std::chrono::nanoseconds> &XModem::ackLatencies()
+{
+    return m_ackLatencies;
+}
+
+const XModem::Summary &XModem::lastUpload()
+{
+    return m_lastUpload;
+}
+
+bool XModem::parsePatch(const std::string &str, Patch &patch)
+{
+    size_t equals = str.find('=');
+    if (equals == std::string::npos || equals == 0 || equals + 1 == str.size()) return false;
+
+    std::string_view offset{str.data(), equals};
+    int base = 10;
+
+    if (offset.starts_with("0x") || offset.starts_with("0X"))
+    {
+        offset.remove_prefix(2);
+        base = 16;
+    }
+
+    auto [end, error] = std::from_chars(offset.data(), offset.data() + offset.size(), patch.offset, base);
+    if (error != std::errc{} || end != offset.data() + offset.size()) return false;
+
+    std::string value = str.substr(equals + 1);
+    patch.bytes.clear();
+
+    // Long hex values are not valid file names, and fail the lookup
+    std::error_code lookupError;
+
+    if (std::filesystem::is_regular_file(value, lookupError))
+    {
+        std::FILE* file = std::fopen(value.c_str(), "rb");
+        if (file == nullptr) return false;
+
+        unsigned char buffer[4096];
+        size_t count;
+
+        while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+            patch.bytes.insert(patch.bytes.end(), buffer, buffer + count);
+
+        bool failed = std::ferror(file);
+        std::fclose(file);
+
+        return !failed && !patch.bytes.empty();
     }
 
-    return "Unknown error " + std::to_string(m_error);
+    if (value.size() % 2 != 0) return false;
+
+    for (size_t i = 0; i < value.size(); i += 2)
+    {
+        unsigned char byte;
+        auto [end, error] = std::from_chars(value.data() + i, value.data() + i + 2, byte, 16);
+        if (error != std::errc{} || end != value.data() + i + 2) return false;
+
+        patch.bytes.push_back(byte);
+    }
+
+    return true;
+}
+
+void XModem::setPatches(const Patches &patches)
+{
+    m_patches = patches;
+}
+
+void XModem::setClock(const Clock& clock)
+{
+    m_clock = clock;
+}
+
+std::chrono::microseconds XModem::steadyClock()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch());
 }
 
 bool XModem::upload(const std::filesystem::path &filePath, const bool& startAfterUpload)
 {
-    unsigned char blockNumber1;
-    unsigned char blockNumber2;
-    unsigned char crcBlock[2];
+    XModemSender sender{m_maxRetry, m_blockSize, m_timeouts, m_clock};
+
+    if (!sender.open(filePath))
+    {
+        m_error = sender.error();
+        publishStatus(sender, true);
+        return false;
+    }
+
+    return upload(sender, startAfterUpload);
+}
+
+bool XModem::upload(std::span<const unsigned char> data, const bool& startAfterUpload)
+{
+    XModemSender sender{m_maxRetry, m_blockSize, m_timeouts, m_clock};
+    sender.open(data);
+
+    return upload(sender, startAfterUpload);
+}
+
+bool XModem::abort()
+{
+    constexpr static unsigned char abort[] {CAN, CAN};
+    m_device.write(abort);
 
-    size_t currentBlock = 0;
-    int32_t currentTry = 0;
+    m_error = Error::ABORTED;
+    return false;
+}
 
-    if (!std::filesystem::exists(filePath))
+bool XModem::upload(XModemSender& sender, const bool& startAfterUpload)
+{
+    if (!sender.patch(m_patches))
     {
-        m_error = Error::FILE_DOES_NOT_EXIST;
+        m_error = sender.error();
+        publishStatus(sender, true);
         return false;
     }
 
-    size_t fileSize = std::filesystem::file_size(filePath);
-    size_t noOfBlocks = std::ceil(float(fileSize) / float(m_blockSize));
+    bool success = send(sender, startAfterUpload);
+    publishStatus(sender, !success);
+
+    m_lastUpload.retries = sender.retries();
+
+    return success;
+}
+
+void XModem::publishStatus(XModemSender& sender, const bool& failed)
+{
+    if (m_sharedStatus == nullptr) return;
+
+    m_sharedStatus->publish(failed ? XModemSender::State::FAILED : sender.state(),
+                            failed ? m_error : Error::NONE,
+                            std::min(sender.currentBlock(), sender.noOfBlocks()), sender.noOfBlocks(),
+                            sender.retries(), std::min(sender.currentBlock(), sender.noOfBlocks()) * m_blockSize);
+}
+
+bool XModem::send(XModemSender& sender, const bool& startAfterUpload)
+{
+    if (m_prefault) sender.prefault();
+
+    // Reserved up front, at most one ACK per block leads to a packet
+    m_ackLatencies.clear();
+    m_ackLatencies.reserve(sender.noOfBlocks());
+
+    unsigned char rb;
+    size_t bytesRead = 0;
 
-    std::ifstream file{filePath, std::ios_base::in | std::ios_base::binary};
+    std::chrono::steady_clock::time_point ackTime;
+    bool acked = false;
 
-    if(!file.is_open())
+    m_lastUpload = {};
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point transferStart;
+    bool handshaken = false;
+
+    while(true)
+    {
+        // Consumed here, so a cancel that arrives between transfers aborts the next one
+        if (m_cancelled.exchange(false)) return abort();
+
+        publishStatus(sender, false);
+
+        // The reply to the last packet may have come back along with it
+        if (bytesRead == 0)
+        {
+            if (!m_device.readSome({&rb, 1}, bytesRead))
+            {
+                m_error = Error::DEVICE_RELATED;
+                return false;
+            }
+        }
+
+        if (bytesRead != 0 && rb == ACK)
+        {
+            ackTime = std::chrono::steady_clock::now();
+            acked = true;
+        }
+
+        XModemSender::Action action = (bytesRead == 0) ? sender.timeout() : sender.respond(rb);
+        bytesRead = 0;
+
+        if (action == XModemSender::Action::SEND_PACKET && acked &&
+                m_ackLatencies.size() < m_ackLatencies.capacity())
+            m_ackLatencies.push_back(std::chrono::steady_clock::now() - ackTime);
+
+        acked = false;
+
+        if (action == XModemSender::Action::SEND_PACKET && !handshaken)
+        {
+            transferStart = std::chrono::steady_clock::now();
+            m_lastUpload.handshakeTime = std::chrono::duration_cast<std::chrono::microseconds>(transferStart - start);
+            handshaken = true;
+        }
+
+        switch (action)
+        {
+        case XModemSender::Action::WAIT:
+            continue;
+
+        case XModemSender::Action::FAIL:
+            m_error = sender.error();
+            return false;
+
+        case XModemSender::Action::SEND_EOT:
+            if (m_drain)
+            {
+                if (!m_device.write(&EOT) || !m_device.drain()) break;
+            }
+            else if (!m_device.transact({&EOT, 1}, {&rb, 1}, bytesRead)) break;
+
+            sender.sent(m_device.pendingTransmitTime());
+            continue;
+
+        case XModemSender::Action::SEND_PACKET:
+            if (m_drain)
+            {
+                if (!m_device.write(sender.packet()) || !m_device.drain()) break;
+            }
+            else if (!m_device.transact(sender.packet(), {&rb, 1}, bytesRead)) break;
+
+            sender.sent(m_device.pendingTransmitTime());
+
+            if (m_progressCallback)
+                m_progressCallback(sender.currentBlock(), sender.noOfBlocks());
+            else
+                sender.showProgress();
+            continue;
+
+        case XModemSender::Action::DONE:
+            if (startAfterUpload)
+                if (!m_device.write(&CR)) break;
+
+            if (!m_progressCallback)
+                Logger::get() << Logger::NewLine;
+
+            m_lastUpload.transferTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - transferStart);
+            m_lastUpload.bytes = sender.noOfBlocks() * m_blockSize;
+
+            sender.close();
+            m_error = Error::NONE;
+            return true;
+        }
+
+        break;
+    }
+
+    m_error = Error::DEVICE_RELATED;
+    return false;
+}
+
+bool XModem::download(const std::filesystem::path &filePath, const bool &stripPadding)
+{
+    WriteBehindFile file;
+
+    if (!file.open(filePath))
     {
         m_error = Error::FILE_OPEN_FAILED;
         return false;
     }
 
-    std::vector<unsigned char> fileBlocks(m_blockSize, 0);
+    constexpr size_t STXBlockSize {1024};
+    size_t maxBlockSize = std::max<size_t>(m_blockSize, STXBlockSize);
 
-    while(true)
+    std::vector<unsigned char> packet(3 + maxBlockSize + 2);
+
+    // The last block is held back until the next one arrives, so that its
+    // padding can still be stripped if it turns out to be the final one
+    std::vector<unsigned char> held;
+    held.reserve(maxBlockSize);
+
+    bool started = false;
+    bool canReceived = false;
+    unsigned char expected = 0;
+    size_t noOfBlocks = 0;
+    int32_t retries = 0;
+
+    auto now = m_clock();
+    auto handshakeDeadline = (m_timeouts.handshake > 0) ?
+                now + std::chrono::milliseconds(m_timeouts.handshake) :
+                std::chrono::microseconds::max();
+    auto replyDeadline = now + std::chrono::milliseconds(m_timeouts.ack);
+
+    if (!m_device.write(&C))
     {
-        unsigned char rb;
+        m_error = Error::DEVICE_RELATED;
+        return false;
+    }
 
-        if (!m_device.read(&rb))
+    // Asks for the block again, or for the transfer to start
+    auto reject = [&](std::string_view reason) {
+        BinaryLogger::get().log(LogRejected, reason);
+
+        replyDeadline = m_clock() + std::chrono::milliseconds(m_timeouts.ack);
+        return m_device.write(started ? &NAK : &C);
+    };
+
+    while (true)
+    {
+        if (m_cancelled.exchange(false)) return abort();
+
+        unsigned char header;
+        size_t bytesRead;
+
+        if (!m_device.readSome({&header, 1}, bytesRead))
         {
             m_error = Error::DEVICE_RELATED;
             return false;
         }
 
-        if (rb != XModem::NAK)
+        if (bytesRead == 0)
         {
-            if (rb == XModem::C)
+            now = m_clock();
+
+            if (!started && now >= handshakeDeadline)
             {
-                blockNumber1 = 0;
-                currentBlock = 1;
-                currentTry = 0;
-                file.seekg(0);
+                m_error = Error::HANDSHAKE_TIMED_OUT;
+                return false;
             }
-            else if (rb == XModem::ACK)
-            {
 
-                if (blockNumber1 == 255)
-                    blockNumber1 = 0;
-                else
-                    blockNumber1++;
+            if (now < replyDeadline) continue;
 
-                currentTry = 0;
-
-                currentBlock++;
+            if (started && ++retries > m_maxRetry)
+            {
+                m_error = Error::MAX_RETRY_SURPASSED;
+                return false;
             }
-            else if (rb == XModem::CAN)
+
+            if (!reject("timeout")) break;
+            continue;
+        }
+
+        if (header == CAN)
+        {
+            if (canReceived)
             {
                 m_error = Error::CANCELLED;
                 return false;
             }
-            else
+
+            canReceived = true;
+            continue;
+        }
+
+        canReceived = false;
+
+        // Before any block it means the sender has nothing to send, which
+        // ends the transfer with an empty file
+        if (header == EOT)
+        {
+            if (!m_device.write(&ACK)) break;
+
+            if (stripPadding)
+                while (!held.empty() && held.back() == SUB)
+                    held.pop_back();
+
+            if (!file.write(held) || !file.close())
             {
-                continue;
+                m_error = Error::FILE_WRITE_FAILED;
+                return false;
             }
 
-            if (file.eof())
-            {
-                if (!m_device.write(&EOT)) break;
+            if (!m_progressCallback)
+                Logger::get() << Logger::NewLine;
 
-                if (startAfterUpload)
-                    if (!m_device.write(&CR)) break;
+            BinaryLogger::get().log(LogFinished, noOfBlocks, retries);
 
-                Logger::get() << Logger::NewLine;
-                file.close();
-                m_error = Error::NONE;
-                return true;
-            }
-            else
+            m_error = Error::NONE;
+            return true;
+        }
+
+        // Anything else between packets is line noise
+        if (header != SOH && header != STX) continue;
+
+        size_t blockSize = (header == STX) ? STXBlockSize : m_blockSize;
+        std::span<unsigned char> rest{packet.data() + 1, 2 + blockSize + 2};
+
+        if (!m_device.read(rest))
+        {
+            if (started && ++retries > m_maxRetry)
             {
-                file.read(reinterpret_cast<char*>(fileBlocks.data()), m_blockSize);
+                m_error = Error::MAX_RETRY_SURPASSED;
+                return false;
+            }
+
+            if (!reject("incomplete")) break;
+            continue;
+        }
+
+        unsigned char number = packet[1];
+        std::span<const unsigned char> data{packet.data() + 3, blockSize};
+        uint16_t crc = (packet[3 + blockSize] << 8) | packet[4 + blockSize];
 
-                if (file.gcount() != m_blockSize)
-                {
-                    for (int32_t i = file.gcount(); i < m_blockSize; i++)
-                        fileBlocks[i] = XModem::SUB;
-                }
+        if (static_cast<unsigned char>(~packet[2]) != number || blockCRC(data) != crc)
+        {
+            if (started && ++retries > m_maxRetry)
+            {
+                m_error = Error::MAX_RETRY_SURPASSED;
+                return false;
             }
+
+            if (!reject("corrupted")) break;
+            continue;
         }
 
-        if (currentTry >= m_maxRetry)
+        // Boards count from either 0 or 1
+        if (!started && (number == 0 || number == 1))
+            expected = number;
+
+        if (started && number == static_cast<unsigned char>(expected - 1))
         {
-            m_error = Error::MAX_RETRY_SURPASSED;
+            // Our ACK got lost
+            BinaryLogger::get().log(LogDuplicate, number);
+
+            if (!m_device.write(&ACK)) break;
+            continue;
+        }
+
+        if (number != expected)
+        {
+            constexpr static unsigned char cancel[] {CAN, CAN};
+            m_device.write(cancel);
+
+            m_error = Error::OUT_OF_SEQUENCE;
+            return false;
+        }
+
+        if (!m_device.write(&ACK)) break;
+
+        if (!file.write(held))
+        {
+            m_error = Error::FILE_WRITE_FAILED;
             return false;
         }
 
-        currentTry++;
+        held.assign(data.begin(), data.end());
 
-        blockNumber2 = 255 - blockNumber1;
-        uint16_t crc = CRC::generateCRC16CCITT(fileBlocks);
-        crcBlock[0] = crc >> 8;
-        crcBlock[1] = crc;
+        started = true;
+        expected++;
+        noOfBlocks++;
+        retries = 0;
+        replyDeadline = m_clock() + std::chrono::milliseconds(m_timeouts.ack);
 
-        if (!m_device.write(&XModem::SOH) ||
-                !m_device.write(&blockNumber1) ||
-                !m_device.write(&blockNumber2) ||
-                !m_device.write(fileBlocks) ||
-                !m_device.write(std::span(crcBlock, 2))) break;
+        BinaryLogger::get().log(LogReceived, number, blockSize);
 
-        Logger::get().showProgress("Sent block " + std::to_string(currentBlock) + "/" + std::to_string(noOfBlocks),
-                                   (float(currentBlock)/float(noOfBlocks)));
+        if (m_progressCallback)
+            m_progressCallback(noOfBlocks, 0);
+        else
+            Logger::get() << "\rReceived block " << noOfBlocks;
     }
 
     m_error = Error::DEVICE_RELATED;
     return false;
 }
-
-
-
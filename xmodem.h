@@ -17,6 +17,13 @@
 #include "device.h"
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <span>
+
+class XModemSender;
+class SharedStatus;
 
 class XModem
 {
@@ -29,25 +36,110 @@ public:
         FILE_DOES_NOT_EXIST,
         FILE_OPEN_FAILED,
         MAX_RETRY_SURPASSED,
-        CANCELLED
+        CANCELLED,
+        ABORTED,
+        PACKET_FILE_INVALID,
+        BLOCK_SIZE_MISMATCH,
+        HANDSHAKE_TIMED_OUT,
+        OUT_OF_SEQUENCE,
+        FILE_WRITE_FAILED,
+        ARCHIVE_INVALID,
+        ARCHIVE_MEMBER_NOT_FOUND,
+        PATCH_OUT_OF_RANGE
+    };
+
+    // In milliseconds. A reply that does not arrive within its timeout makes
+    // the sender retransmit, waiting twice as long every time up to maxBackoff.
+    struct Timeouts
+    {
+        int32_t handshake = 60000;  // for the first 'C', 0 waits forever
+        int32_t ack = 2000;         // for the ACK/NAK of a packet
+        int32_t eotAck = 2000;      // for the ACK of EOT
+        int32_t maxBackoff = 16000;
+        double jitter = 0.25;       // +- fraction added to every wait
+    };
+
+    // How the last upload went, the transfer time starts once the target
+    // has answered the handshake
+    struct Summary
+    {
+        std::chrono::microseconds handshakeTime {0};
+        std::chrono::microseconds transferTime {0};
+        size_t bytes = 0;
+        int32_t retries = 0;
+    };
+
+    // Bytes overlaid on the image at offset while it is framed, the file
+    // itself is left untouched
+    struct Patch
+    {
+        size_t offset;
+        std::vector<unsigned char> bytes;
     };
 
+    using Patches = std::vector<Patch>;
+
+    using ProgressCallback = std::function<void(const size_t& block, const size_t& noOfBlocks)>;
+    using Clock = std::function<std::chrono::microseconds()>;
+
     XModem(Device& device,
            const int32_t& maxRetry,
            const int32_t& blockSize);
 
     const Error& error();
     std::string errorStr();
+    static std::string errorStr(const Error& error);
 
     bool upload(const std::filesystem::path& filePath, const bool& startAfterUpload);
+    bool upload(std::span<const unsigned char> data, const bool& startAfterUpload);
 
-private:
-    Error m_error;
-    Device& m_device;
-    int32_t m_maxRetry;
-    int32_t m_blockSize;
+    // Receives a file sent by the target into filePath. Blocks are
+    // acknowledged before they reach the disk. SUB padding at the end of the
+    // last block is removed if stripPadding is set. The progress callback
+    // gets 0 as noOfBlocks, since the size is not known in advance.
+    bool download(const std::filesystem::path& filePath, const bool& stripPadding);
+
+    // Replaces the progress bar, called after every block sent
+    void setProgressCallback(const ProgressCallback& callback);
+
+    // Aborts the running transfer, or the next one if none is running.
+    // Safe to call from any thread
+    void cancel();
+
+    void setTimeouts(const Timeouts& timeouts);
+
+    // Touches every page of the image before the handshake
+    void setPrefault(const bool& prefault);
+
+    // Waits for every packet to be transmitted before starting its ACK
+    // timeout and reporting progress. Without it the timeout is pushed back
+    // by whatever the device reports as still queued for transmission.
+    void setDrain(const bool& drain);
+
+    // Publishes the state of every upload into status, nullptr disables it
+    void setSharedStatus(SharedStatus* status);
+
+    // Time from reading the ACK of a packet to starting to write the next
+    // one, for every block of the last upload
+    const std::vector<std::chrono::nanoseconds>& ackLatencies();
+
+    const Summary& lastUpload();
+
+    // Parses offset=file or offset=hex, with the offset in decimal or
+    // 0x-prefixed hex. The value is read from the file if one exists at that
+    // path, otherwise it is taken as hex bytes, e.g. 0x400=00a1b2c3 or
+    // 4096=calibration.bin
+    static bool parsePatch(const std::string& str, Patch& patch);
+
+    // Applied in order to every upload, later patches win where they overlap
+    void setPatches(const Patches& patches);
+
+    // Source of time for timeouts, defaults to std::chrono::steady_clock
+    void setClock(const Clock& clock);
+    static std::chrono::microseconds steadyClock();
 
     constexpr static unsigned char SOH   {0x01};
+    constexpr static unsigned char STX   {0x02};
     constexpr static unsigned char EOT   {0x04};
     constexpr static unsigned char ACK   {0x06};
     constexpr static unsigned char NAK   {0x15};
@@ -55,6 +147,27 @@ private:
     constexpr static unsigned char SUB   {0x1a};
     constexpr static unsigned char CR    {0x1d};
     constexpr static unsigned char C     {'C'};
+
+private:
+    Error m_error;
+    Device& m_device;
+    int32_t m_maxRetry;
+    int32_t m_blockSize;
+    ProgressCallback m_progressCallback;
+    Timeouts m_timeouts;
+    Clock m_clock;
+    std::atomic<bool> m_cancelled;
+    bool m_prefault;
+    bool m_drain;
+    SharedStatus* m_sharedStatus;
+    std::vector<std::chrono::nanoseconds> m_ackLatencies;
+    Summary m_lastUpload;
+    Patches m_patches;
+
+    bool upload(XModemSender& sender, const bool& startAfterUpload);
+    bool send(XModemSender& sender, const bool& startAfterUpload);
+    void publishStatus(XModemSender& sender, const bool& failed);
+    bool abort();
 };
 
 #endif // XMODEM_H
@@ -0,0 +1,687 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "xmodemsender.h"
+#include "crc.h"
+#include "logger.h"
+#include "binarylogger.h"
+
+#include <algorithm>
+#include <charconv>
+#include <mutex>
+
+#ifdef VEGADUDE_MINIMAL
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace
+{
+std::atomic<uint32_t> nextUploadId {0};
+
+const uint16_t LogStarted = BinaryLogger::registerFormat("upload {}: target ready, sending {} blocks of {} bytes");
+const uint16_t LogAcknowledged = BinaryLogger::registerFormat("upload {}: block {}/{} acknowledged");
+const uint16_t LogRetransmit = BinaryLogger::registerFormat("upload {}: {} for block {}, sending try {}/{}");
+const uint16_t LogRetransmitEOT = BinaryLogger::registerFormat("upload {}: {} for EOT, sending try {}/{}");
+const uint16_t LogSingleCAN = BinaryLogger::registerFormat("upload {}: ignoring single CAN");
+const uint16_t LogFailed = BinaryLogger::registerFormat("upload {}: failed, {}");
+const uint16_t LogFinished = BinaryLogger::registerFormat("upload {}: finished after {} retries");
+}
+
+XModemSender::XModemSender(const int32_t& maxRetry,
+                           const int32_t& blockSize,
+                           const XModem::Timeouts& timeouts,
+                           const XModem::Clock& clock)
+    : m_error{XModem::Error::NONE},
+      m_maxRetry{maxRetry},
+      m_blockSize{blockSize},
+      m_timeouts{timeouts},
+      m_clock{clock},
+      m_state{State::HANDSHAKE},
+      m_deadline{0},
+      m_canReceived{false},
+      m_retries{0},
+      m_packed{false},
+      m_noOfBlocks{0},
+      m_currentBlock{0},
+      m_currentTry{0},
+      m_frame{},
+      m_framer{framer(blockSize)},
+      m_id{nextUploadId++}
+{
+    size_t packetSize = 3 + blockSize + 2;
+
+    if (static_cast<size_t>(blockSize) <= MaxFixedBlockSize)
+    {
+        m_packet = std::span{m_frame}.first(packetSize);
+    }
+    else
+    {
+        m_largeFrame.resize(packetSize);
+        m_packet = m_largeFrame;
+    }
+}
+
+const XModem::Error &XModemSender::error()
+{
+    return m_error;
+}
+
+bool XModemSender::open(const std::filesystem::path& filePath)
+{
+    std::filesystem::path archivePath;
+    std::string memberPath;
+
+    if (Archive::splitMemberPath(filePath.string(), archivePath, memberPath))
+    {
+        std::error_code existsError;
+
+        if (!std::filesystem::exists(archivePath, existsError))
+        {
+            m_error = XModem::Error::FILE_DOES_NOT_EXIST;
+            return false;
+        }
+
+        std::span<const unsigned char> member;
+
+        if (!m_archive.open(archivePath) || !m_archive.find(memberPath, member))
+        {
+            switch (m_archive.error())
+            {
+            case Archive::Error::OPEN_FAILED:
+                m_error = XModem::Error::FILE_OPEN_FAILED;
+                break;
+            case Archive::Error::MEMBER_NOT_FOUND:
+            case Archive::Error::NOT_A_FILE:
+                m_error = XModem::Error::ARCHIVE_MEMBER_NOT_FOUND;
+                break;
+            default:
+                m_error = XModem::Error::ARCHIVE_INVALID;
+            }
+
+            m_archive.close();
+            return false;
+        }
+
+        return open(member);
+    }
+
+    std::error_code fileError;
+
+    if (!std::filesystem::exists(filePath, fileError))
+    {
+        m_error = XModem::Error::FILE_DOES_NOT_EXIST;
+        return false;
+    }
+
+    if (filePath.extension() == PacketFile::Extension)
+    {
+        if (!m_packetFile.open(filePath))
+        {
+            m_error = XModem::Error::PACKET_FILE_INVALID;
+            return false;
+        }
+
+        if (m_packetFile.blockSize() != m_blockSize)
+        {
+            m_error = XModem::Error::BLOCK_SIZE_MISMATCH;
+            return false;
+        }
+
+        m_packed = true;
+        m_noOfBlocks = m_packetFile.noOfBlocks();
+        m_currentBlock = 0;
+        m_currentTry = 0;
+        m_currentPacket = m_packet;
+
+        beginHandshake();
+
+        m_error = XModem::Error::NONE;
+        return true;
+    }
+
+    // Taken before reading, so a write in the meantime does not leave
+    // packets of the old contents cached under the new time
+    auto modified = std::filesystem::last_write_time(filePath, fileError);
+    if (fileError) modified = std::filesystem::file_time_type::min();
+
+#ifdef VEGADUDE_MINIMAL
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    struct stat st;
+
+    if (fd == -1 || fstat(fd, &st) != 0)
+    {
+        if (fd != -1) ::close(fd);
+
+        m_error = XModem::Error::FILE_OPEN_FAILED;
+        return false;
+    }
+
+    // Images are small, reading them once avoids seeking back on every restart
+    m_fileData.resize(st.st_size);
+
+    size_t filled = 0;
+
+    while (filled < m_fileData.size())
+    {
+        ssize_t count = ::read(fd, m_fileData.data() + filled, m_fileData.size() - filled);
+        if (count <= 0) break;
+
+        filled += count;
+    }
+
+    ::close(fd);
+
+    if (filled != m_fileData.size())
+    {
+        m_error = XModem::Error::FILE_OPEN_FAILED;
+        return false;
+    }
+#else
+    std::ifstream file{filePath, std::ios_base::in | std::ios_base::binary};
+
+    if(!file.is_open())
+    {
+        m_error = XModem::Error::FILE_OPEN_FAILED;
+        return false;
+    }
+
+    // Images are small, reading them once avoids seeking back on every restart
+    auto size = std::filesystem::file_size(filePath, fileError);
+
+    if (fileError)
+    {
+        m_error = XModem::Error::FILE_OPEN_FAILED;
+        return false;
+    }
+
+    m_fileData.resize(size);
+    file.read(reinterpret_cast<char*>(m_fileData.data()), m_fileData.size());
+
+    if (file.gcount() != static_cast<std::streamsize>(m_fileData.size()))
+    {
+        m_error = XModem::Error::FILE_OPEN_FAILED;
+        return false;
+    }
+#endif
+
+    open(std::span<const unsigned char>{m_fileData});
+
+    if (modified != std::filesystem::file_time_type::min())
+    {
+        m_imagePath = filePath;
+        m_imageModified = modified;
+    }
+
+    return true;
+}
+
+bool XModemSender::open(std::span<const unsigned char> data)
+{
+    m_data = data;
+    m_imagePath.clear();
+    m_framed.reset();
+    m_packed = false;
+    m_noOfBlocks = (m_data.size() + m_blockSize - 1) / m_blockSize;
+
+    m_currentBlock = 0;
+    m_currentTry = 0;
+    m_currentPacket = m_packet;
+
+    beginHandshake();
+
+    m_error = XModem::Error::NONE;
+    return true;
+}
+
+bool XModemSender::patch(std::span<const XModem::Patch> patches)
+{
+    size_t imageSize = m_packed ? m_packetFile.imageSize() : m_data.size();
+
+    for (auto& patch : patches)
+    {
+        if (patch.offset > imageSize || patch.bytes.size() > imageSize - patch.offset)
+        {
+            m_error = XModem::Error::PATCH_OUT_OF_RANGE;
+            return false;
+        }
+    }
+
+    m_patches = patches;
+    m_patchedBlock.resize(patches.empty() ? 0 : m_blockSize);
+
+    // Without patches every packet is framed on the fly into m_packet,
+    // which costs nothing extra and keeps no copy of the image around
+    if (!patches.empty() && !m_packed && !m_imagePath.empty())
+        m_framed = framedImage();
+    else
+        m_framed.reset();
+
+    m_error = XModem::Error::NONE;
+    return true;
+}
+
+void XModemSender::close()
+{
+    m_data = {};
+    m_patches = {};
+    m_imagePath.clear();
+    m_framed.reset();
+    m_fileData.clear();
+    m_packetFile.close();
+    m_archive.close();
+}
+
+void XModemSender::prefault()
+{
+    constexpr size_t PageSize {4096};
+
+    // Volatile, so the reads are not optimised away
+    auto touch = [](const unsigned char& byte) {
+        *static_cast<const volatile unsigned char*>(&byte);
+    };
+
+    if (m_packed)
+    {
+        for (size_t i = 0; i < m_noOfBlocks; i++)
+            touch(m_packetFile.packet(i).front());
+    }
+    else
+    {
+        for (size_t i = 0; i < m_data.size(); i += PageSize)
+            touch(m_data[i]);
+    }
+}
+
+void XModemSender::frame(std::span<unsigned char> packet,
+                         const size_t& blockIndex,
+                         std::span<const unsigned char> data)
+{
+    framer(packet.size() - 5)(packet, blockIndex, data);
+}
+
+XModemSender::Framer XModemSender::framer(const size_t &blockSize)
+{
+    static_assert(std::size(FixedBlockSizes) == 2);
+
+    switch (blockSize)
+    {
+    case FixedBlockSizes[0]:
+        return &frameFixed<FixedBlockSizes[0]>;
+    case FixedBlockSizes[1]:
+        return &frameFixed<FixedBlockSizes[1]>;
+    default:
+        return &frameGeneric;
+    }
+}
+
+template<size_t BlockSize>
+void XModemSender::frameFixed(std::span<unsigned char> packet,
+                              const size_t& blockIndex,
+                              std::span<const unsigned char> data)
+{
+    frame<BlockSize>(packet.first<3 + BlockSize + 2>(), blockIndex, data);
+}
+
+void XModemSender::frameGeneric(std::span<unsigned char> packet,
+                                const size_t& blockIndex,
+                                std::span<const unsigned char> data)
+{
+    std::span<unsigned char> block = packet.subspan(3, packet.size() - 5);
+
+    packet[0] = XModem::SOH;
+    packet[1] = blockIndex;
+    packet[2] = 255 - packet[1];
+
+    std::copy(data.begin(), data.end(), block.begin());
+    std::fill(block.begin() + data.size(), block.end(), XModem::SUB);
+
+    uint16_t crc = CRC::generateCRC16CCITT(block);
+    packet[packet.size() - 2] = crc >> 8;
+    packet[packet.size() - 1] = crc;
+}
+
+std::shared_ptr<const XModemSender::FramedImage> XModemSender::framedImage()
+{
+    // Shared by every sender of the process, concurrent uploads of the same
+    // image to many boards frame it once between them
+    static std::mutex mutex;
+    static std::shared_ptr<const FramedImage> cached;
+
+    size_t packetSize = 3 + m_blockSize + 2;
+
+    std::lock_guard lock{mutex};
+
+    if (cached && cached->path == m_imagePath && cached->modified == m_imageModified &&
+            cached->blockSize == m_blockSize && cached->packets.size() == m_noOfBlocks * packetSize)
+        return cached;
+
+    auto framed = std::make_shared<FramedImage>();
+    framed->path = m_imagePath;
+    framed->modified = m_imageModified;
+    framed->blockSize = m_blockSize;
+    framed->packets.resize(m_noOfBlocks * packetSize);
+
+    for (size_t i = 0; i < m_noOfBlocks; i++)
+    {
+        size_t offset = i * m_blockSize;
+        size_t count = std::min<size_t>(m_blockSize, m_data.size() - offset);
+
+        m_framer(std::span{framed->packets}.subspan(i * packetSize, packetSize),
+                 i, m_data.subspan(offset, count));
+    }
+
+    cached = framed;
+    return cached;
+}
+
+bool XModemSender::patched(const size_t &offset, const size_t &count)
+{
+    return std::any_of(m_patches.begin(), m_patches.end(), [&](const XModem::Patch& patch) {
+        return patch.offset < offset + count && patch.offset + patch.bytes.size() > offset;
+    });
+}
+
+void XModemSender::prepare(const size_t& blockIndex)
+{
+    size_t offset = blockIndex * m_blockSize;
+    size_t count = m_packed ? m_blockSize : std::min<size_t>(m_blockSize, m_data.size() - offset);
+
+    if (!patched(offset, count))
+    {
+        if (m_packed)
+        {
+            m_currentPacket = m_packetFile.packet(blockIndex);
+        }
+        else if (m_framed)
+        {
+            size_t packetSize = m_packet.size();
+            m_currentPacket = std::span<const unsigned char>{m_framed->packets}.subspan(blockIndex * packetSize, packetSize);
+        }
+        else
+        {
+            m_framer(m_packet, blockIndex, m_data.subspan(offset, count));
+            m_currentPacket = m_packet;
+        }
+        return;
+    }
+
+    // Packed blocks already carry their SUB padding
+    std::span<const unsigned char> data = m_packed ?
+                m_packetFile.packet(blockIndex).subspan(3, m_blockSize) : m_data.subspan(offset, count);
+
+    std::copy(data.begin(), data.end(), m_patchedBlock.begin());
+
+    for (auto& patch : m_patches)
+    {
+        size_t first = std::max(patch.offset, offset);
+        size_t last = std::min(patch.offset + patch.bytes.size(), offset + count);
+
+        if (first < last)
+            std::copy(patch.bytes.begin() + (first - patch.offset), patch.bytes.begin() + (last - patch.offset),
+                      m_patchedBlock.begin() + (first - offset));
+    }
+
+    m_framer(m_packet, blockIndex, std::span{m_patchedBlock}.first(count));
+    m_currentPacket = m_packet;
+}
+
+void XModemSender::beginHandshake()
+{
+    m_state = State::HANDSHAKE;
+    m_canReceived = false;
+    m_retries = 0;
+
+    auto now = m_clock();
+    m_random.seed(now.count());
+
+    if (m_timeouts.handshake > 0)
+        m_deadline = now + std::chrono::milliseconds(m_timeouts.handshake);
+    else
+        m_deadline = std::chrono::microseconds::max();
+}
+
+XModemSender::Action XModemSender::fail(const XModem::Error& error)
+{
+    m_state = State::FAILED;
+    m_error = error;
+
+    BinaryLogger::get().log(LogFailed, m_id, XModem::errorStr(error));
+
+    return Action::FAIL;
+}
+
+void XModemSender::startWaiting(const int32_t& timeout)
+{
+    // Exponential backoff on every retry of the same packet, with jitter so
+    // that sender and receiver timeouts do not stay in lockstep
+    double wait = std::min<double>(double(timeout) * (1 << std::min(m_currentTry - 1, 16)),
+                                   m_timeouts.maxBackoff);
+
+    std::uniform_real_distribution<double> jitter{-m_timeouts.jitter, m_timeouts.jitter};
+    wait *= 1 + jitter(m_random);
+
+    m_deadline = m_clock() + std::chrono::microseconds(static_cast<int64_t>(wait * 1000));
+}
+
+void XModemSender::sent(const std::chrono::microseconds& transmitTime)
+{
+    if (m_state == State::SENDING)
+    {
+        m_state = State::AWAITING_ACK;
+        startWaiting(m_timeouts.ack);
+    }
+    else if (m_state == State::AWAITING_EOT_ACK)
+    {
+        startWaiting(m_timeouts.eotAck);
+    }
+    else
+    {
+        return;
+    }
+
+    m_deadline += transmitTime;
+}
+
+XModemSender::Action XModemSender::retransmit(std::string_view reason)
+{
+    if (m_currentTry >= m_maxRetry)
+        return fail(XModem::Error::MAX_RETRY_SURPASSED);
+
+    m_currentTry++;
+    m_retries++;
+
+    if (m_state == State::AWAITING_EOT_ACK)
+    {
+        BinaryLogger::get().log(LogRetransmitEOT, m_id, reason, m_currentTry, m_maxRetry);
+        return Action::SEND_EOT;
+    }
+
+    BinaryLogger::get().log(LogRetransmit, m_id, reason, m_currentBlock, m_currentTry, m_maxRetry);
+
+    m_state = State::SENDING;
+    return Action::SEND_PACKET;
+}
+
+XModemSender::Action XModemSender::respond(const unsigned char& response)
+{
+    Action action = handle(response);
+
+    // Noise never reaches timeout(), as the read that brought it was not empty
+    if (action == Action::WAIT && m_clock() >= m_deadline)
+        return timeout();
+
+    return action;
+}
+
+XModemSender::Action XModemSender::handle(const unsigned char& response)
+{
+    // A single CAN is likely line noise, the receiver sends two
+    if (response == XModem::CAN)
+    {
+        if (m_canReceived)
+            return fail(XModem::Error::CANCELLED);
+
+        m_canReceived = true;
+        BinaryLogger::get().log(LogSingleCAN, m_id);
+        return Action::WAIT;
+    }
+
+    m_canReceived = false;
+
+    switch (m_state)
+    {
+    case State::HANDSHAKE:
+        if (response != XModem::C) return Action::WAIT;
+        break;
+
+    case State::AWAITING_ACK:
+        if (response == XModem::NAK)
+            return retransmit("NAK");
+
+        // Still asking to start, the first packet did not make it
+        if (response == XModem::C && m_currentBlock == 1)
+            return retransmit("C");
+
+        if (response != XModem::ACK) return Action::WAIT;
+
+        BinaryLogger::get().log(LogAcknowledged, m_id, m_currentBlock, m_noOfBlocks);
+
+        m_currentBlock++;
+        break;
+
+    case State::AWAITING_EOT_ACK:
+        if (response == XModem::NAK)
+            return retransmit("NAK");
+
+        if (response != XModem::ACK) return Action::WAIT;
+
+        m_state = State::FINISHED;
+        m_error = XModem::Error::NONE;
+
+        BinaryLogger::get().log(LogFinished, m_id, m_retries);
+
+        return Action::DONE;
+
+    default:
+        return Action::WAIT;
+    }
+
+    if (m_state == State::HANDSHAKE)
+    {
+        m_currentBlock = 1;
+        BinaryLogger::get().log(LogStarted, m_id, m_noOfBlocks, m_blockSize);
+    }
+
+    m_currentTry = 1;
+
+    if (m_currentBlock > m_noOfBlocks)
+    {
+        m_state = State::AWAITING_EOT_ACK;
+        return Action::SEND_EOT;
+    }
+
+    prepare(m_currentBlock - 1);
+    m_state = State::SENDING;
+    return Action::SEND_PACKET;
+}
+
+XModemSender::Action XModemSender::timeout()
+{
+    if (m_clock() < m_deadline) return Action::WAIT;
+
+    switch (m_state)
+    {
+    case State::HANDSHAKE:
+        return fail(XModem::Error::HANDSHAKE_TIMED_OUT);
+
+    case State::AWAITING_ACK:
+    case State::AWAITING_EOT_ACK:
+        return retransmit("timeout");
+
+    default:
+        return Action::WAIT;
+    }
+}
+
+const XModemSender::State &XModemSender::state()
+{
+    return m_state;
+}
+
+std::string XModemSender::stateStr(const State &state)
+{
+    switch (state)
+    {
+    case HANDSHAKE:
+        return "Waiting for handshake";
+    case SENDING:
+        return "Sending";
+    case AWAITING_ACK:
+        return "Waiting for ACK";
+    case AWAITING_EOT_ACK:
+        return "Waiting for ACK of EOT";
+    case FINISHED:
+        return "Finished";
+    case FAILED:
+        return "Failed";
+    }
+
+    return "Unknown state " + std::to_string(state);
+}
+
+const int32_t &XModemSender::retries()
+{
+    return m_retries;
+}
+
+std::span<const unsigned char> XModemSender::packet()
+{
+    return m_currentPacket;
+}
+
+const size_t &XModemSender::currentBlock()
+{
+    return m_currentBlock;
+}
+
+const size_t &XModemSender::noOfBlocks()
+{
+    return m_noOfBlocks;
+}
+
+void XModemSender::showProgress()
+{
+    // Formatted on the stack, nothing is allocated for the blocks of an upload
+    constexpr std::string_view prefix {"Sent block "};
+    std::array<char, prefix.size() + 2 * 20 + 1> message;
+
+    char* end = std::copy(prefix.begin(), prefix.end(), message.begin());
+
+    auto current = std::to_chars(end, message.end(), m_currentBlock);
+    end = current.ptr;
+
+    if (current.ec == std::errc{} && end != message.end())
+    {
+        *end++ = '/';
+
+        auto total = std::to_chars(end, message.end(), m_noOfBlocks);
+        if (total.ec == std::errc{}) end = total.ptr;
+    }
+
+    Logger::get().showProgress({message.data(), size_t(end - message.data())},
+                               (float(m_currentBlock)/float(m_noOfBlocks)));
+}
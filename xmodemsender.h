@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2023 Debayan Sutradhar (rnayabed) (debayansutradhar3@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef XMODEMSENDER_H
+#define XMODEMSENDER_H
+
+#include "xmodem.h"
+#include "packetfile.h"
+#include "archive.h"
+#include "crc.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Protocol side of an XMODEM upload, independent of how bytes are moved.
+// Drivers feed it every byte received from the target, call timeout() when a
+// read comes back empty, call sent() once a packet or EOT has been written,
+// and act on the returned action. Bytes that are ignored also check the
+// deadline, so a target that keeps printing cannot hold it off.
+class XModemSender
+{
+public:
+
+    enum State
+    {
+        HANDSHAKE,
+        SENDING,
+        AWAITING_ACK,
+        AWAITING_EOT_ACK,
+        FINISHED,
+        FAILED
+    };
+
+    enum Action
+    {
+        SEND_PACKET,
+        SEND_EOT,
+        WAIT,
+        DONE,
+        FAIL
+    };
+
+    XModemSender(const int32_t& maxRetry,
+                 const int32_t& blockSize,
+                 const XModem::Timeouts& timeouts,
+                 const XModem::Clock& clock);
+
+    const XModem::Error& error();
+
+    // Files ending in PacketFile::Extension are sent as already framed
+    // packets. Paths like bundle.tar:board.bin send a member of an archive
+    // straight from the mapped archive.
+    bool open(const std::filesystem::path& filePath);
+    // data has to stay valid until the upload is finished
+    bool open(std::span<const unsigned char> data);
+    void close();
+
+    // Overlays patches on the opened image, patches has to stay valid until
+    // the upload is finished. Only packets of blocks they touch are framed
+    // again, the others are sent as they are, straight from the packet file
+    // for packed images. Raw image files are framed once per run and the
+    // packets shared by every upload of the same file.
+    bool patch(std::span<const XModem::Patch> patches);
+
+    // Reads every page of the image once, so that sending it later does
+    // not stop for page faults
+    void prefault();
+
+    Action respond(const unsigned char& response);
+    Action timeout();
+    // transmitTime is how long the written bytes still need to leave the
+    // device, the reply timeout starts once they have
+    void sent(const std::chrono::microseconds& transmitTime);
+
+    const State& state();
+    static std::string stateStr(const State& state);
+    const int32_t& retries();
+
+    std::span<const unsigned char> packet();
+
+    const size_t& currentBlock();
+    const size_t& noOfBlocks();
+
+    void showProgress();
+
+    // Writes SOH, block number, its complement, data padded with SUB and CRC
+    // into packet, which must be 3 + blockSize + 2 bytes long. Block sizes in
+    // FixedBlockSizes run through a version specialised for their size.
+    static void frame(std::span<unsigned char> packet,
+                      const size_t& blockIndex,
+                      std::span<const unsigned char> data);
+
+    template<size_t BlockSize>
+    static void frame(std::span<unsigned char, 3 + BlockSize + 2> packet,
+                      const size_t& blockIndex,
+                      std::span<const unsigned char> data)
+    {
+        packet[0] = XModem::SOH;
+        packet[1] = blockIndex;
+        packet[2] = 255 - packet[1];
+
+        std::span<unsigned char, BlockSize> block = packet.template subspan<3, BlockSize>();
+
+        std::copy(data.begin(), data.end(), block.begin());
+        std::fill(block.begin() + data.size(), block.end(), XModem::SUB);
+
+        uint16_t crc = CRC::generateCRC16CCITT(std::span<const unsigned char, BlockSize>{block});
+        packet[3 + BlockSize] = crc >> 8;
+        packet[4 + BlockSize] = crc;
+    }
+
+    constexpr static size_t FixedBlockSizes[] {128, 1024};
+    constexpr static size_t MaxFixedBlockSize {1024};
+
+private:
+    XModem::Error m_error;
+    int32_t m_maxRetry;
+    int32_t m_blockSize;
+    XModem::Timeouts m_timeouts;
+    XModem::Clock m_clock;
+
+    State m_state;
+    std::chrono::microseconds m_deadline;
+    std::minstd_rand m_random;
+    bool m_canReceived;
+    int32_t m_retries;
+
+    std::vector<unsigned char> m_fileData;
+    std::span<const unsigned char> m_data;
+    PacketFile m_packetFile;
+    Archive m_archive;
+    bool m_packed;
+
+    // Packets of a raw image file, framed once and kept for later uploads
+    // of the file as long as it is unchanged
+    struct FramedImage
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type modified;
+        int32_t blockSize;
+        std::vector<unsigned char> packets;
+    };
+
+    std::filesystem::path m_imagePath;
+    std::filesystem::file_time_type m_imageModified;
+    std::shared_ptr<const FramedImage> m_framed;
+
+    std::span<const XModem::Patch> m_patches;
+    // Block data with the patches applied, framed into m_packet
+    std::vector<unsigned char> m_patchedBlock;
+
+    size_t m_noOfBlocks;
+    size_t m_currentBlock;
+    int32_t m_currentTry;
+
+    using Framer = void (*)(std::span<unsigned char> packet,
+                            const size_t& blockIndex,
+                            std::span<const unsigned char> data);
+
+    // Packets are built in m_frame, only block sizes above
+    // MaxFixedBlockSize need m_largeFrame
+    std::array<unsigned char, 3 + MaxFixedBlockSize + 2> m_frame;
+    std::vector<unsigned char> m_largeFrame;
+    std::span<unsigned char> m_packet;
+    Framer m_framer;
+    std::span<const unsigned char> m_currentPacket;
+
+    // Tells uploads apart in the binary log
+    uint32_t m_id;
+
+    void prepare(const size_t& blockIndex);
+    std::shared_ptr<const FramedImage> framedImage();
+    bool patched(const size_t& offset, const size_t& count);
+
+    static Framer framer(const size_t& blockSize);
+
+    template<size_t BlockSize>
+    static void frameFixed(std::span<unsigned char> packet,
+                           const size_t& blockIndex,
+                           std::span<const unsigned char> data);
+    static void frameGeneric(std::span<unsigned char> packet,
+                             const size_t& blockIndex,
+                             std::span<const unsigned char> data);
+    void beginHandshake();
+    Action fail(const XModem::Error& error);
+    Action retransmit(std::string_view reason);
+    Action handle(const unsigned char& response);
+    void startWaiting(const int32_t& timeout);
+};
+
+#endif // XMODEMSENDER_H